@@ -0,0 +1,206 @@
+// Agreement.cpp
+//
+// Copyright (C) 2008-2013, ir. R.L. Pijl
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "agreement.h"
+
+// two-sided 99%
+#define Z 2.5758
+
+AgreementMonitor::AgreementMonitor()
+{
+	matches=0;
+	samples=0;
+	threshold=0.6;
+}
+
+AgreementMonitor::~AgreementMonitor()
+{
+	free(matches);
+}
+
+bool
+AgreementMonitor::AddReference(const char* name)
+{
+	int* grown;
+
+	if (references.Load(name))
+		return true;
+	grown=(int*)realloc(matches,references.GetCount()*sizeof(int));
+	if (!grown)
+		return true;
+	matches=grown;
+	matches[references.GetCount()-1]=0;
+	return false;
+}
+
+int
+AgreementMonitor::GetReferenceCount(void)
+{
+	return references.GetCount();
+}
+
+int
+AgreementMonitor::GetPositions(void)
+{
+	return references.GetPositions();
+}
+
+unsigned long long
+AgreementMonitor::GetSuiteHash(void)
+{
+	return references.GetSuiteHash();
+}
+
+void
+AgreementMonitor::SetThreshold(double fraction)
+{
+	threshold=fraction;
+}
+
+void
+AgreementMonitor::Record(int index, int move)
+{
+	// a null move never counts as agreement, as in simcompare
+	if (index<0 || index>=references.GetPositions())
+		return;
+	for (int r=0; r<references.GetCount(); r++)
+		if (move && references.GetMoves(r)[index]==(fpmove_t)move)
+			matches[r]++;
+	samples++;
+}
+
+int
+AgreementMonitor::GetSamples(void)
+{
+	return samples;
+}
+
+void
+AgreementMonitor::Interval(int k, double* low, double* high)
+{
+	// Wilson score interval, it stays inside [0,1] and behaves well for
+	// rates close to 0 or 1
+	double n=samples;
+	double p, d, centre, half;
+
+	if (samples==0) {
+		*low=0.0;
+		*high=1.0;
+		return;
+	}
+	p=k/n;
+	d=1.0+Z*Z/n;
+	centre=(p+Z*Z/(2*n))/d;
+	half=Z*sqrt(p*(1-p)/n+Z*Z/(4*n*n))/d;
+	*low=centre-half;
+	*high=centre+half;
+}
+
+bool
+AgreementMonitor::IsDecided(void)
+{
+	if (samples<MINSAMPLES || references.GetCount()==0)
+		return false;
+	for (int r=0; r<references.GetCount(); r++) {
+		double low, high;
+
+		Interval(matches[r],&low,&high);
+		if (low<=threshold && high>=threshold)
+			return false;
+	}
+	return true;
+}
+
+void
+AgreementMonitor::Print(FILE* fp)
+{
+	for (int r=0; r<references.GetCount(); r++) {
+		double low, high;
+
+		Interval(matches[r],&low,&high);
+		fprintf(fp,"%s: %.2f%% over %d positions, 99%% interval %.2f-%.2f%%, %s\n",
+			references.GetName(r),samples ? 100.0*matches[r]/samples : 0.0,samples,
+			100*low,100*high,low>threshold ? "similar" : high<threshold ? "not similar" : "undecided");
+	}
+}
+
+const char*
+AgreementMonitor::GetErrorStr(void)
+{
+	return references.GetErrorStr();
+}
+
+typedef struct {
+	double key;
+	int index;
+} orderKey_t;
+
+static int compareKeys(const void* a, const void* b)
+{
+	const orderKey_t* ka=(const orderKey_t*)a;
+	const orderKey_t* kb=(const orderKey_t*)b;
+
+	if (ka->key!=kb->key)
+		return ka->key<kb->key ? -1 : 1;
+	return ka->index-kb->index;
+}
+
+static unsigned int nextRandom(unsigned int* state)
+{
+	// xorshift32, the same order on every platform
+	*state^=*state<<13;
+	*state^=*state>>17;
+	*state^=*state<<5;
+	return *state;
+}
+
+void StratifiedOrder(const int* strata, int n, unsigned int seed, int* order)
+{
+	// The k-th of the m positions of a stratum gets the key (k+u)/m with u
+	// random in [0,1), sorting on the keys interleaves the strata.
+	orderKey_t* keys=new orderKey_t[n];
+	int* size;
+	int* taken;
+	int maxStratum=0;
+	unsigned int state=seed ? seed : 1;
+
+	for (int i=0; i<n; i++)
+		if (strata[i]>maxStratum)
+			maxStratum=strata[i];
+	size=new int[maxStratum+1];
+	taken=new int[maxStratum+1];
+	memset(size,0,(maxStratum+1)*sizeof(int));
+	memset(taken,0,(maxStratum+1)*sizeof(int));
+	for (int i=0; i<n; i++)
+		size[strata[i]]++;
+
+	// a random permutation, so the k-th of a stratum is a random member
+	for (int i=0; i<n; i++)
+		order[i]=i;
+	for (int i=n-1; i>0; i--) {
+		int j=nextRandom(&state)%(i+1);
+		int t=order[i];
+
+		order[i]=order[j];
+		order[j]=t;
+	}
+	for (int i=0; i<n; i++) {
+		int s=strata[order[i]];
+		double u=(nextRandom(&state)>>8)/16777216.0;
+
+		keys[i].key=(taken[s]++ +u)/size[s];
+		keys[i].index=order[i];
+	}
+	qsort(keys,n,sizeof(orderKey_t),compareKeys);
+	for (int i=0; i<n; i++)
+		order[i]=keys[i].index;
+
+	delete[] keys;
+	delete[] size;
+	delete[] taken;
+}
@@ -0,0 +1,57 @@
+// Agreement.h
+// Running agreement with reference fingerprints, to stop a run early
+//
+// Copyright (C) 2008-2013, ir. R.L. Pijl
+
+#ifndef __AGREEMENT_H
+#define __AGREEMENT_H
+
+#include <stdio.h>
+#include "fpset.h"
+
+// For every reference the fraction of positions with the same best move is
+// estimated with a Wilson score interval. The run can stop once all
+// intervals lie completely above or below the threshold.
+class AgreementMonitor
+{
+public:
+	AgreementMonitor();
+	virtual ~AgreementMonitor();
+
+	// A fingerprint of the same suite, epd or binary. Returns true on error.
+	bool AddReference(const char* name);
+	int GetReferenceCount(void);
+	int GetPositions(void);
+	unsigned long long GetSuiteHash(void);
+
+	// Threshold as a fraction, 0.6 for 60%
+	void SetThreshold(double fraction);
+
+	// The best move found for position index of the suite
+	void Record(int index, int move);
+	int GetSamples(void);
+
+	// At least MINSAMPLES positions are done and every reference is
+	// either similar or not with 99% confidence
+	enum { MINSAMPLES=100 };
+	bool IsDecided(void);
+
+	void Print(FILE* fp);
+
+	const char* GetErrorStr(void);
+
+private:
+	FingerprintSet references;
+	int* matches;
+	int samples;
+	double threshold;
+
+	void Interval(int k, double* low, double* high);
+};
+
+// An order of n positions in which every stratum is represented in
+// proportion to its size from the start, random within the strata. The
+// same seed gives the same order.
+void StratifiedOrder(const int* strata, int n, unsigned int seed, int* order);
+
+#endif // __AGREEMENT_H
@@ -0,0 +1,452 @@
+// Batch.cpp
+//
+// Copyright (C) 2008-2013, ir. R.L. Pijl
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "batch.h"
+#include "util.h"
+
+Batch::Batch()
+{
+	engines=0;
+	engineCount=0;
+	settings=0;
+	lines=0;
+	positions=0;
+	coreBusy=0;
+	freeCores=0;
+	running=0;
+	finished=0;
+	strcpy(error,"Ok");
+}
+
+Batch::~Batch()
+{
+	for (int i=0; i<engineCount; i++) {
+		batchEngine_t* e=&engines[i];
+
+		free(e->name);
+		free(e->exec);
+		for (int k=0; k<e->optionCount; k++) {
+			free(e->optionIds[k]);
+			free(e->optionValues[k]);
+		}
+		free(e->optionIds);
+		free(e->optionValues);
+		delete[] e->moves;
+		delete[] e->retry;
+		delete[] e->attempts;
+		delete[] e->top;
+		delete[] e->topCount;
+	}
+	free(engines);
+	delete[] lines;
+	delete[] coreBusy;
+}
+
+static char* trim(char* s)
+{
+	char* end;
+
+	while (isspace((unsigned char)*s)) s++;
+	end=s+strlen(s);
+	while (end>s && isspace((unsigned char)end[-1])) end--;
+	*end='\0';
+	return s;
+}
+
+bool
+Batch::Load(const char* manifest)
+{
+	char buf[1024];
+	FILE* fp=fopen(manifest,"r");
+	int lineNumber=0;
+
+	if (!fp) {
+		snprintf(error,sizeof(error),"Could not open the manifest %s",manifest);
+		return true;
+	}
+	while (fgets(buf,sizeof(buf),fp)) {
+		char *s=trim(buf), *next=s, *word;
+
+		lineNumber++;
+		if (*s=='\0' || *s=='#')
+			continue;
+		word=NextToken(&next," \t");
+		if (strcmp(word,"engine")==0) {
+			char *name=NextToken(&next," \t"), *type=NextToken(&next," \t");
+			char *threads=NextToken(&next," \t");
+			batchEngine_t* e;
+
+			if (!next || !type || (toupper(*type)!='U' && toupper(*type)!='W') || atoi(threads)<1) {
+				snprintf(error,sizeof(error),"%s:%d: expected engine <name> <U|W> <threads> <executable>",
+					manifest,lineNumber);
+				fclose(fp);
+				return true;
+			}
+			engines=(batchEngine_t*)realloc(engines,(engineCount+1)*sizeof(batchEngine_t));
+			e=&engines[engineCount++];
+			memset(e,0,sizeof(batchEngine_t));
+			e->name=strdup(name);
+			e->type=toupper(*type)=='U' ? EnginePool::poolUCI : EnginePool::poolWB;
+			e->threads=atoi(threads);
+			e->exec=strdup(trim(next));
+		} else if (strcmp(word,"option")==0 && engineCount>0 && next && strchr(next,'=')) {
+			batchEngine_t* e=&engines[engineCount-1];
+			char* value=strchr(next,'=');
+
+			*value++='\0';
+			e->optionIds=(char**)realloc(e->optionIds,(e->optionCount+1)*sizeof(char*));
+			e->optionValues=(char**)realloc(e->optionValues,(e->optionCount+1)*sizeof(char*));
+			e->optionIds[e->optionCount]=strdup(trim(next));
+			e->optionValues[e->optionCount]=strdup(trim(value));
+			e->optionCount++;
+		} else {
+			snprintf(error,sizeof(error),"%s:%d: expected an engine or an option line",manifest,lineNumber);
+			fclose(fp);
+			return true;
+		}
+	}
+	fclose(fp);
+	if (engineCount==0) {
+		snprintf(error,sizeof(error),"The manifest %s has no engines",manifest);
+		return true;
+	}
+	return false;
+}
+
+int
+Batch::GetEngineCount(void)
+{
+	return engineCount;
+}
+
+bool batchResult(const EnginePool::result_t* result, void* param)
+{
+	// called from the thread of the instance
+	Batch::instance_t* instance=(Batch::instance_t*)param;
+	Batch* batch=instance->batch;
+	Batch::batchEngine_t* e=instance->engine;
+	int index=instance->taken[result->id];
+	int n=result->topCount;
+
+	// a position the engine could not search keeps no best move, as in main
+	e->moves[index]=result->failed ? -1 : result->bestMove;
+	if (e->top && !result->failed) {
+		memcpy(&e->top[index*Engine::MAXMULTIPV],result->topMoves,n*sizeof(int));
+		e->topCount[index]=n;
+	}
+	batch->lock.Lock();
+	instance->delivered++;
+	if (!result->failed)
+		e->done++;
+	else if (++e->attempts[index]<Batch::MAXATTEMPTS) {
+		// another instance, or this one with a restarted engine, tries again
+		e->retry[e->retryCount++]=index;
+		batch->lock.Unlock();
+		return false;
+	} else
+		e->givenUp++;
+	batch->finished++;
+	batch->lock.Unlock();
+	return false;
+}
+
+bool
+Batch::StartPool(EnginePool* pool, instance_t* instance)
+{
+	// the settings of a single engine run, see main
+	batchEngine_t* e=instance->engine;
+	bool threadsSet=false;
+
+	pool->SetAffinity(instance->cores,instance->coreCount);
+	if (pool->StartEngines(e->type,e->exec,".",1))
+		return true;
+	for (int k=0; k<e->optionCount; k++) {
+		if (pool->SetOption(e->optionIds[k],e->optionValues[k]))
+			return true;
+		if (strcmp(e->optionIds[k],"Threads")==0 || strcmp(e->optionIds[k],"Cores")==0)
+			threadsSet=true;
+	}
+	// the threads of the manifest, unless an option sets them already
+	if (!threadsSet && pool->SetThreads(e->threads) && e->threads>1) {
+		lock.Lock();
+		if (!e->warned)
+			fprintf(stderr,"\nWARNING: %s cannot be given %d threads, it runs with its default\n",
+				e->name,e->threads);
+		e->warned=true;
+		lock.Unlock();
+	}
+	if (pool->Synchronize())
+		return true;
+	pool->SetResultHandler(batchResult,instance);
+	pool->SetPipelined(settings->pipelined);
+	if (settings->nodes>0 ? pool->SetSearchNodes(settings->nodes)
+	 : settings->depth>0 ? pool->SetSearchDepth(settings->depth)
+	 : pool->SetSearchTimeMs(settings->movetime))
+		return true;
+	if (pool->SetMultiPV(settings->multiPV) || pool->SetIsolation(settings->isolation))
+		return true;
+	pool->SetWatchdog(settings->watchdog);
+	return false;
+}
+
+int batchThread(void* param)
+{
+	Batch::instance_t* instance=(Batch::instance_t*)param;
+	Batch* batch=instance->batch;
+	Batch::batchEngine_t* e=instance->engine;
+	EnginePool pool;
+	bool complete=false;
+
+	instance->failed=batch->StartPool(&pool,instance);
+	if (instance->failed) {
+		fprintf(stderr,"\nERROR: %s: %s\n",e->name,pool.GetErrorStr());
+		for (int i=0; i<pool.GetCount(); i++)
+			if (!pool.GetEngine(i)->Kill())
+				pool.GetEngine(i)->WaitForStop();
+	} else {
+		for (;;) {
+			int index=-1;
+
+			batch->lock.Lock();
+			if (e->retryCount>0)
+				index=e->retry[--e->retryCount];
+			else if (e->next<batch->positions)
+				index=e->next++;
+			batch->lock.Unlock();
+			if (index<0) {
+				// positions may be given back while the last ones are searched
+				bool more;
+
+				pool.WaitForAll();
+				batch->lock.Lock();
+				more=e->retryCount>0;
+				batch->lock.Unlock();
+				if (!more)
+					break;
+				continue;
+			}
+			instance->taken[instance->takenCount++]=index;
+			if (pool.Analyse(batch->lines[index].position.ptr,batch->lines[index].position.length)) {
+				fprintf(stderr,"\nERROR: %s: %s\n",e->name,pool.GetErrorStr());
+				break;
+			}
+		}
+		pool.WaitForAll();
+		pool.Stop();
+	}
+
+	batch->lock.Lock();
+	for (int i=0; i<instance->coreCount; i++)
+		batch->coreBusy[instance->cores[i]]=false;
+	batch->freeCores+=instance->coreCount;
+	// the positions that were taken but never delivered are handed out
+	// again, an engine that does not start is given a few more chances
+	for (int i=instance->delivered; i<instance->takenCount; i++) {
+		int index=instance->taken[i];
+
+		if (++e->attempts[index]<Batch::MAXATTEMPTS)
+			e->retry[e->retryCount++]=index;
+		else {
+			e->moves[index]=-1;
+			e->givenUp++;
+			batch->finished++;
+		}
+	}
+	if (instance->failed) {
+		if (++e->startFailures>=Batch::MAXSTARTS)
+			e->failed=true;
+	} else
+		e->startFailures=0;
+	e->instances--;
+	complete=e->instances==0 && e->done+e->givenUp==batch->positions;
+	batch->lock.Unlock();
+
+	// the last instance of an engine writes its fingerprint
+	if (complete) {
+		if (batch->Write(e))
+			fprintf(stderr,"\nERROR: Could not write %s.epd\n",e->name);
+		else
+			fprintf(stderr,"\n%s done.\n",e->name);
+	}
+
+	batch->lock.Lock();
+	batch->running--;
+	batch->changed.Signal();
+	batch->lock.Unlock();
+	delete[] instance->taken;
+	delete instance;
+	return 0;
+}
+
+bool
+Batch::StartInstances(void)
+{
+	// called with the lock held
+	for (;;) {
+		batchEngine_t* best=0;
+		double bestScore=0.0;
+		instance_t* instance;
+
+		// the most positions left per instance, weighted by the threads, so
+		// the engines that take longest are started first
+		for (int i=0; i<engineCount; i++) {
+			batchEngine_t* e=&engines[i];
+			int left=positions-e->next+e->retryCount;
+			double score;
+
+			if (e->failed || e->threads>freeCores || left<=e->instances)
+				continue;
+			score=(double)left*e->threads/(e->instances+1);
+			if (score>bestScore) {
+				best=e;
+				bestScore=score;
+			}
+		}
+		if (!best)
+			return false;
+
+		instance=new instance_t;
+		instance->batch=this;
+		instance->engine=best;
+		instance->coreCount=0;
+		for (int c=0; c<settings->cores && instance->coreCount<best->threads; c++) {
+			if (!coreBusy[c]) {
+				coreBusy[c]=true;
+				instance->cores[instance->coreCount++]=c;
+			}
+		}
+		freeCores-=instance->coreCount;
+		instance->taken=new int[positions*MAXATTEMPTS];
+		instance->takenCount=0;
+		instance->delivered=0;
+		instance->failed=false;
+		best->instances++;
+		running++;
+		if (StartThread(batchThread,instance)) {
+			// give the processors back and do not try this again
+			for (int i=0; i<instance->coreCount; i++)
+				coreBusy[instance->cores[i]]=false;
+			freeCores+=instance->coreCount;
+			best->instances--;
+			best->failed=true;
+			running--;
+			delete[] instance->taken;
+			delete instance;
+			return true;
+		}
+	}
+}
+
+bool
+Batch::Write(batchEngine_t* e)
+{
+	char name[1024];
+	FILE* out;
+
+	snprintf(name,sizeof(name),"%s.epd",e->name);
+	out=fopen(name,"w");
+	if (!out)
+		return true;
+	for (int i=0; i<positions; i++) {
+		// a position that was not searched has no opcodes
+		if (e->moves[i]<0) {
+			fprintf(out,"%.*s\n",lines[i].position.length,lines[i].position.ptr);
+			continue;
+		}
+		fprintf(out,"%.*s bm %s",lines[i].position.length,lines[i].position.ptr,MoveStr(e->moves[i]));
+		if (e->top) {
+			fprintf(out,"; top");
+			for (int k=0; k<e->topCount[i]; k++)
+				fprintf(out," %s",MoveStr(e->top[i*Engine::MAXMULTIPV+k]));
+			fprintf(out,";");
+		}
+		fprintf(out,"\n");
+	}
+	return fclose(out)!=0;
+}
+
+bool
+Batch::Run(const char* epdName, const batchSettings_t* s)
+{
+	EpdReader epd;
+	bool rv=false, givenUp=false;
+
+	settings=s;
+	if (settings->cores<1 || settings->cores>Engine::MAXCORES) {
+		snprintf(error,sizeof(error),"The budget must be 1 to %d processors",(int)Engine::MAXCORES);
+		return true;
+	}
+	for (int i=0; i<engineCount; i++) {
+		if (engines[i].threads>settings->cores) {
+			snprintf(error,sizeof(error),"%s needs %d processors, more than the budget of %d",
+				engines[i].name,engines[i].threads,settings->cores);
+			return true;
+		}
+	}
+	if (epd.Open(epdName)) {
+		snprintf(error,sizeof(error),"Could not open the epd-file %s",epdName);
+		return true;
+	}
+	positions=epd.Count();
+	lines=new epdLine_t[positions];
+	for (int i=0; i<positions && epd.Next(&lines[i]); i++)
+		;
+	for (int i=0; i<engineCount; i++) {
+		batchEngine_t* e=&engines[i];
+
+		e->moves=new int[positions];
+		memset(e->moves,0,positions*sizeof(int));
+		e->retry=new int[positions];
+		e->attempts=new unsigned char[positions];
+		memset(e->attempts,0,positions);
+		if (settings->multiPV>1) {
+			e->top=new int[positions*Engine::MAXMULTIPV];
+			e->topCount=new unsigned char[positions];
+			memset(e->topCount,0,positions);
+		}
+	}
+	coreBusy=new bool[settings->cores];
+	memset(coreBusy,0,settings->cores*sizeof(bool));
+	freeCores=settings->cores;
+
+	lock.Lock();
+	for (;;) {
+		if (StartInstances())
+			fprintf(stderr,"\nERROR: Could not start a thread\n");
+		if (running==0)
+			break;
+		changed.Wait(lock,250);
+		fprintf(stderr,"\rBatch: %d/%d positions, %d instances on %d processors ",
+			finished,positions*engineCount,running,settings->cores-freeCores);
+	}
+	lock.Unlock();
+	fprintf(stderr,"\rBatch: %d/%d positions \nDone.\n",finished,positions*engineCount);
+
+	for (int i=0; i<engineCount; i++) {
+		if (engines[i].done+engines[i].givenUp<positions) {
+			fprintf(stderr,"ERROR: %s could not be fingerprinted\n",engines[i].name);
+			rv=true;
+		} else if (engines[i].givenUp) {
+			fprintf(stderr,"WARNING: %s could not search %d positions, they have no best move\n",
+				engines[i].name,engines[i].givenUp);
+			givenUp=true;
+		}
+	}
+	// the fields of the lines point into the mapping
+	epd.Close();
+	strcpy(error,rv ? "Not all engines could be fingerprinted"
+		: givenUp ? "Not all positions could be searched" : "Ok");
+	return rv || givenUp;
+}
+
+const char*
+Batch::GetErrorStr(void)
+{
+	return error;
+}
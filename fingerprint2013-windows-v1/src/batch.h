@@ -0,0 +1,113 @@
+// Batch.h
+// Fingerprinting of many engines that share one budget of processors
+//
+// Copyright (C) 2008-2013, ir. R.L. Pijl
+
+#ifndef __BATCH_H
+#define __BATCH_H
+
+#include "enginepool.h"
+#include "epd.h"
+#include "platform.h"
+
+typedef struct {
+	int cores;		// processors 0..cores-1 are used
+	bool pipelined;
+	int movetime;
+	long long nodes;
+	int depth;
+	int multiPV;
+	int isolation;
+	int watchdog;
+} batchSettings_t;
+
+// Every engine of the manifest is fingerprinted by instances of one engine
+// process each, pinned to as many processors as the engine has threads. An
+// instance takes the next position of its engine until there are none
+// left, a processor that becomes free goes to the engine with the most
+// work left. No processor idles while any engine has positions left.
+class Batch
+{
+public:
+	Batch();
+	virtual ~Batch();
+
+	// The manifest has a line per engine,
+	//   engine <name> <U|W> <threads> <executable> [<arguments>]
+	// followed by the options of that engine, one per line,
+	//   option <id>=<value>
+	// The engine is given the threads as its Threads or Cores option (UCI)
+	// or with cores (WB), unless an option line sets these.
+	// Empty lines and lines starting with # are skipped. Returns true on
+	// error.
+	bool Load(const char* manifest);
+	int GetEngineCount(void);
+
+	// Fingerprint all engines, the result of engine <name> is written to
+	// <name>.epd. Returns true when not all engines could be fingerprinted.
+	bool Run(const char* epdName, const batchSettings_t* settings);
+
+	const char* GetErrorStr(void);
+
+	// A position an instance took but could not search is handed out
+	// again, up to MAXATTEMPTS times in all. An engine is given up after
+	// MAXSTARTS instances in a row that could not be started.
+	enum { MAXATTEMPTS=2, MAXSTARTS=3 };
+
+private:
+	typedef struct {
+		char* name;
+		int type;
+		int threads;
+		char* exec;
+		char** optionIds;
+		char** optionValues;
+		int optionCount;
+		int next;		// first position that was not handed out
+		int* retry;		// positions to hand out again
+		int retryCount;
+		unsigned char* attempts;
+		int startFailures;	// instances in a row that did not start
+		int done;
+		int givenUp;		// positions the pool could not search
+		int instances;
+		bool failed;		// no further instances are started
+		bool warned;
+		int* moves;
+		int* top;
+		unsigned char* topCount;
+	} batchEngine_t;
+
+	typedef struct {
+		Batch* batch;
+		batchEngine_t* engine;
+		int cores[Engine::MAXCORES];
+		int coreCount;
+		int* taken;		// the positions in the order they were analysed
+		int takenCount;
+		int delivered;		// results of taken, in the same order
+		bool failed;		// the engines could not be started
+	} instance_t;
+
+	batchEngine_t* engines;
+	int engineCount;
+	const batchSettings_t* settings;
+	epdLine_t* lines;
+	int positions;
+	bool* coreBusy;
+	int freeCores;
+	int running;
+	int finished;
+	Mutex lock;
+	Condition changed;
+	char error[256];
+
+	bool StartInstances(void);
+	bool StartPool(EnginePool* pool, instance_t* instance);
+	bool Write(batchEngine_t* engine);
+
+	friend int batchThread(void* param);
+	friend bool batchResult(const EnginePool::result_t* result, void* param);
+};
+
+#endif // __BATCH_H
@@ -1,288 +1,1025 @@
-// Engine.cpp
-//
-// Copyright (C) 2008-2013, ir. R.L. Pijl
-
-#include <stdio.h>
-#include <direct.h>
-#include <fcntl.h>
-#include <io.h>
-#include <process.h>
-#include "engine.h"
-
-const char *
-Engine::errorStrings[100] = {
-	"Ok", // 0
-	"Other error",
-	"Could not change the working directory",
-	"Could not allocate more memory",
-	"Engine name not specified",
-	"Creating Engine command pipe failed", // 5
-	"Creating Engine result pipe failed",
-	"Duplicating pipe to input failed",
-	"Duplicating pipe to output failed",
-	"Could not restore stdin",
-	"Could not restore stdout", // 10
-	"Could not start the engine process",
-	"Opening filestream for engine command pipe failed",
-	"Opening filestream for engine result pipe failed",
-	"Engine process did not terminate",
-	"Copyprotection error", // 15
-	"Position is not specified",
-	"Engine has already started",
-	"Engine has not yet started",
-	"Engine is not searching",
-	"Engine is already searching", // 20
-	"Could not start a thread for collecting the engine responses",
-	"No Final Response handler specified in call to Search",
-	"Requested feature is not supported in this engine",
-	"Illegal Position",
-	"Engine does not allow setting options" // 25
-};
-
-Engine::Engine()
-{
-	engineWorkingDir=0;
-	engineExecName=0;
-	toengine=0;
-	fromengine=0;
-	engineid=0;
-	started=false;
-	searching=false;
-	optionPonder=false;
-	ponderMode=false;
-	optionMultiPV=false;
-	multiPV=1;
-	multiPVmin=1;
-	multiPVmax=1;
-	optionShowCurrline=false;
-	showCurrline=false;
-	optionShowRefute=false;
-	showRefutation=false;
-	optionAnalyzeMode=false;
-	pvHandler=0;
-	finHandler=0;
-	cmHandler=0;
-	refHandler=0;
-	strHandler=0;
-}
-
-Engine::~Engine()
-{
-	if (engineWorkingDir)
-		delete engineWorkingDir;
-	if (engineExecName)
-		delete engineExecName;
-	if (toengine) {
-		fclose(toengine);
-		toengine=0;
-	}
-	if (fromengine) {
-		fclose(fromengine);
-		fromengine=0;
-	}
-}
-
-bool 
-Engine::SetWorkingDir(const char* wdir)
-{
-	if (engineWorkingDir) {
-		delete engineWorkingDir;
-		engineWorkingDir=0;
-	}
-	engineWorkingDir=new char[strlen(wdir)+1];
-	if (!engineWorkingDir) {
-		errorNumber=ENGINENOMEM;
-		return true;
-	}
-
-	strcpy(engineWorkingDir,wdir);
-	errorNumber=ENGINEOK;
-	return false;
-}
-
-bool
-Engine::SetExecName(const char* exec)
-{
-	if (engineExecName) {
-		delete engineExecName;
-		engineExecName=0;
-	}
-	engineExecName=new char[strlen(exec)+1];
-	if (!engineExecName) {
-		errorNumber=ENGINENOMEM;
-		return true;
-	}
-
-	strcpy(engineExecName,exec);
-	errorNumber=ENGINEOK;
-	return false;
-}
-
-bool
-Engine::StartEngine(void)
-{
-	int fdStdOut, fdStdIn;
-	char *args[16];
-	char buf[1024];
-	char *s;
-	int i=0;
-
-	if (started) {
-		errorNumber=ENGINEALREADYSTARTED;
-		return true;
-	}
-	if (engineWorkingDir)
-		if (_chdir(engineWorkingDir)) {
-			errorNumber=ENGINENODIR;
-			return true;
-		}
-	if (!engineExecName) {
-		errorNumber=ENGINENONAME;
-		return true;
-	}
-
-	strcpy (buf,engineExecName);
-	s=strtok(buf," \n\r\t");
-	do {
-		args[i++]=strdup(s);
-		s=strtok(0," \t\n\r");
-	} while (s);
-	args[i]=0;
-
-	// Change directory to the engine directory
-	// Prepare I/O pipes
-	if (_pipe(enginepipe,4096,O_TEXT|O_NOINHERIT)==-1) {
-		errorNumber=ENGINECMDPIPE;
-		return true;
-	}
-	if (_pipe(enginerespipe,4096,O_TEXT|O_NOINHERIT)==-1) {
-		errorNumber=ENGINERESPIPE;
-		return true;
-	}
-
-	// Duplicate std file descriptors (next line will close original)
-	fdStdOut = _dup(_fileno(stdout));
-	fdStdIn = _dup(_fileno(stdin));
-
-	// Duplicate write end of pipe to stdout file descriptor
-	if(_dup2(enginerespipe[WRITE], _fileno(stdout)) != 0) {
-		errorNumber=ENGINEPIPEOUT;
-		return true;
-	}
-	if(_dup2(enginepipe[READ], _fileno(stdin)) != 0) {
-		errorNumber=ENGINEPIPEIN;
-		return true;
-	}
-
-	// Close original write end of pipe
-	_close(enginerespipe[WRITE]);
-	_close(enginepipe[READ]);
-
-	// Start the engine
-	engineid=_spawnv(P_NOWAIT, args[0], args );
-
-	// Duplicate copy of original stdout back into stdout
-	if(_dup2(fdStdOut, _fileno(stdout)) != 0) {
-		errorNumber=ENGINESTDOUT;
-		return true;
-	}
-	if(_dup2(fdStdIn, _fileno(stdin)) != 0) {
-		errorNumber=ENGINESTDIN;
-		return true;
-	}
-
-	// Close duplicate copy of original stdout
-	_close(fdStdOut);
-	_close(fdStdIn);
-
-	if (engineid<=0) {
-		errorNumber=ENGINEPROCSTART;
-		return true;
-	}
-
-	// Connect I/O pipes properly
-	toengine=_fdopen(enginepipe[WRITE],"w");
-	if (!toengine) {
-		errorNumber=ENGINEFDCMDPIPE;
-		// TODO: Stop the engine process
-		return true;
-	}
-	fromengine=_fdopen(enginerespipe[READ],"r");
-	if (!fromengine) {
-		errorNumber=ENGINEFDRESPIPE;
-		// TODO: Stop the engine process
-		return true;
-	}
-
-	setbuf(toengine,0);
-	started=true;
-
-	return InitEngine();
-}
-
-bool
-Engine::SetOption(const char* id, const char* value)
-{
-	errorNumber=ENGINENOOPT;
-	return true;
-}
-
-bool
-Engine::Synchronize(void)
-{
-	return false;
-}
-
-bool
-Engine::WaitForStop(void)
-{
-	char buf[2048];
-	int i=0;
-
-	fclose(toengine);
-	toengine=0;
-	do {
-		i++;
-		if (i==0) break;
-		fgets(buf,2047,fromengine);
-	} while (!feof(fromengine));
-	if (i==0) {
-		// TODO kill engine
-		errorNumber=ENGINENOTERM;
-		return true;
-	}
-	engineid=0;
-	fromengine=0;
-	started=false;
-
-	errorNumber=ENGINEOK;
-	return false;
-}
-
-int 
-Engine::GetError(void)
-{
-	return errorNumber;
-}
-
-const char*
-Engine::GetErrorStr()
-{
-	if (errorNumber>=0 && errorNumber<100)
-		return errorStrings[errorNumber];
-	else
-		return errorStrings[1];
-}
-
-DWORD WINAPI startResponseThread(LPVOID lpParam)
-{
-	// this function is called when creating a response thread
-    Engine* engine;
-
-    engine = (Engine*)lpParam;
-
-	if (engine->ResponseThread()) {
-		return 1;
-	}
-	return 0;
-}
+// Engine.cpp
+//
+// Copyright (C) 2008-2013, ir. R.L. Pijl
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#ifdef _WIN32
+#include <direct.h>
+#include <io.h>
+#include <process.h>
+#else
+#include <errno.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/wait.h>
+
+extern char **environ;
+#endif
+#include "engine.h"
+#include "reactor.h"
+#include "util.h"
+
+const char *
+Engine::errorStrings[100] = {
+	"Ok", // 0
+	"Other error",
+	"Could not change the working directory",
+	"Could not allocate more memory",
+	"Engine name not specified",
+	"Creating Engine command pipe failed", // 5
+	"Creating Engine result pipe failed",
+	"Duplicating pipe to input failed",
+	"Duplicating pipe to output failed",
+	"Could not restore stdin",
+	"Could not restore stdout", // 10
+	"Could not start the engine process",
+	"Opening filestream for engine command pipe failed",
+	"Opening filestream for engine result pipe failed",
+	"Engine process did not terminate",
+	"Copyprotection error", // 15
+	"Position is not specified",
+	"Engine has already started",
+	"Engine has not yet started",
+	"Engine is not searching",
+	"Engine is already searching", // 20
+	"Could not start a thread for collecting the engine responses",
+	"No Final Response handler specified in call to Search",
+	"Requested feature is not supported in this engine",
+	"Illegal Position",
+	"Engine does not allow setting options", // 25
+	"Could not start the engine output reactor",
+	"Engine closed its output",
+	"Engine did not respond in time"
+};
+
+Engine::Engine()
+{
+	engineWorkingDir=0;
+	engineExecName=0;
+	affinityCount=0;
+	toengine=0;
+	fromengine=-1;
+	engineid=0;
+	inSize=4096;
+	inBuffer=new char[inSize];
+	inLength=0;
+	inClosed=false;
+	deadlineTimer=0;
+	searchDeadline=0;
+	watchdog=0;
+	stopSent=false;
+	queueHead=0;
+	queueLength=0;
+	started=false;
+	searching=false;
+	optionPonder=false;
+	ponderMode=false;
+	optionMultiPV=false;
+	multiPV=1;
+	multiPVmin=1;
+	multiPVmax=1;
+	optionShowCurrline=false;
+	showCurrline=false;
+	optionShowRefute=false;
+	showRefutation=false;
+	optionAnalyzeMode=false;
+	pvHandler=0;
+	finHandler=0;
+	cmHandler=0;
+	refHandler=0;
+	strHandler=0;
+	doneHandler=0;
+	doneParam=0;
+	bestMove=0;
+	ponderMove=0;
+	bestMoveText[0]='\0';
+	lastFinishUs=0;
+	ResetStats();
+	lastStats=runningStats;
+	lastTopCount=0;
+}
+
+Engine::~Engine()
+{
+	if (engineWorkingDir)
+		delete engineWorkingDir;
+	if (engineExecName)
+		delete engineExecName;
+	if (toengine) {
+		fclose(toengine);
+		toengine=0;
+	}
+	if (fromengine>=0) {
+		Reactor::Get()->Remove(this);
+#ifdef _WIN32
+		_close(fromengine);
+#else
+		close(fromengine);
+#endif
+		fromengine=-1;
+	}
+	DisarmDeadline();
+	delete[] inBuffer;
+	while (queueLength>0) {
+		free(queued[queueHead]);
+		queueHead=(queueHead+1)%MAXQUEUED;
+		queueLength--;
+	}
+}
+
+bool 
+Engine::SetWorkingDir(const char* wdir)
+{
+	if (engineWorkingDir) {
+		delete engineWorkingDir;
+		engineWorkingDir=0;
+	}
+	engineWorkingDir=new char[strlen(wdir)+1];
+	if (!engineWorkingDir) {
+		errorNumber=ENGINENOMEM;
+		return true;
+	}
+
+	strcpy(engineWorkingDir,wdir);
+	errorNumber=ENGINEOK;
+	return false;
+}
+
+bool
+Engine::SetExecName(const char* exec)
+{
+	if (engineExecName) {
+		delete engineExecName;
+		engineExecName=0;
+	}
+	engineExecName=new char[strlen(exec)+1];
+	if (!engineExecName) {
+		errorNumber=ENGINENOMEM;
+		return true;
+	}
+
+	strcpy(engineExecName,exec);
+	errorNumber=ENGINEOK;
+	return false;
+}
+
+const char*
+Engine::GetExecName(void)
+{
+	return engineExecName ? engineExecName : "";
+}
+
+void
+Engine::SetAffinity(const int* cores, int n)
+{
+	affinityCount=n<MAXCORES ? n : MAXCORES;
+	memcpy(affinity,cores,affinityCount*sizeof(int));
+}
+
+#ifdef _WIN32
+// the standard handles of the whole process are redirected while an engine
+// is spawned, engines started from several threads take turns
+static Mutex spawnLock;
+#endif
+
+#ifndef _WIN32
+static int makePipe(int fd[2])
+{
+	// both ends are close-on-exec, the child only gets the dup2'ed copies
+#ifdef __linux__
+	return pipe2(fd,O_CLOEXEC);
+#else
+	if (pipe(fd)==-1) return -1;
+	fcntl(fd[0],F_SETFD,FD_CLOEXEC);
+	fcntl(fd[1],F_SETFD,FD_CLOEXEC);
+	return 0;
+#endif
+}
+#endif
+
+bool
+Engine::StartEngine(void)
+{
+	return StartProcess() || InitEngine();
+}
+
+bool
+Engine::StartProcess(void)
+{
+	char *args[16];
+	char buf[1024];
+	char *s, *next;
+	int i=0;
+
+	if (started) {
+		errorNumber=ENGINEALREADYSTARTED;
+		return true;
+	}
+	if (engineWorkingDir)
+#ifdef _WIN32
+		if (_chdir(engineWorkingDir)) {
+#else
+		if (chdir(engineWorkingDir)) {
+#endif
+			errorNumber=ENGINENODIR;
+			return true;
+		}
+	if (!engineExecName) {
+		errorNumber=ENGINENONAME;
+		return true;
+	}
+
+	// the arguments point into buf
+	snprintf(buf,sizeof(buf),"%s",engineExecName);
+	next=buf;
+	s=NextToken(&next," \n\r\t");
+	while (s && i<15) {
+		args[i++]=s;
+		s=NextToken(&next," \t\n\r");
+	}
+	args[i]=0;
+	if (i==0) {
+		errorNumber=ENGINENONAME;
+		return true;
+	}
+
+#ifdef _WIN32
+	int fdStdOut, fdStdIn;
+
+	// Change directory to the engine directory
+	// Prepare I/O pipes
+	if (_pipe(enginepipe,4096,O_TEXT|O_NOINHERIT)==-1) {
+		errorNumber=ENGINECMDPIPE;
+		return true;
+	}
+	if (_pipe(enginerespipe,4096,O_TEXT|O_NOINHERIT)==-1) {
+		_close(enginepipe[READ]);
+		_close(enginepipe[WRITE]);
+		errorNumber=ENGINERESPIPE;
+		return true;
+	}
+
+	// Duplicate std file descriptors (next line will close original)
+	spawnLock.Lock();
+	fdStdOut = _dup(_fileno(stdout));
+	fdStdIn = _dup(_fileno(stdin));
+
+	// Duplicate write end of pipe to stdout file descriptor
+	if(_dup2(enginerespipe[WRITE], _fileno(stdout)) != 0) {
+		spawnLock.Unlock();
+		errorNumber=ENGINEPIPEOUT;
+		return true;
+	}
+	if(_dup2(enginepipe[READ], _fileno(stdin)) != 0) {
+		spawnLock.Unlock();
+		errorNumber=ENGINEPIPEIN;
+		return true;
+	}
+
+	// Close original write end of pipe
+	_close(enginerespipe[WRITE]);
+	_close(enginepipe[READ]);
+
+	// Start the engine
+	engineid=_spawnv(P_NOWAIT, args[0], args );
+
+	// Duplicate copy of original stdout back into stdout
+	if(_dup2(fdStdOut, _fileno(stdout)) != 0) {
+		spawnLock.Unlock();
+		errorNumber=ENGINESTDOUT;
+		return true;
+	}
+	if(_dup2(fdStdIn, _fileno(stdin)) != 0) {
+		spawnLock.Unlock();
+		errorNumber=ENGINESTDIN;
+		return true;
+	}
+
+	// Close duplicate copy of original stdout
+	_close(fdStdOut);
+	_close(fdStdIn);
+	spawnLock.Unlock();
+
+	if (engineid<=0) {
+		_close(enginepipe[WRITE]);
+		_close(enginerespipe[READ]);
+		engineid=0;
+		errorNumber=ENGINEPROCSTART;
+		return true;
+	}
+	if (affinityCount)
+		SetProcessAffinity(engineid,affinity,affinityCount);
+
+	// Connect I/O pipes properly
+	fromengine=enginerespipe[READ];
+	toengine=_fdopen(enginepipe[WRITE],"w");
+	if (!toengine) {
+		_close(enginepipe[WRITE]);
+		Kill();
+		ClosePipes();
+		errorNumber=ENGINEFDCMDPIPE;
+		return true;
+	}
+#else
+	posix_spawn_file_actions_t actions;
+	pid_t pid;
+	int rc;
+
+	// A dying engine must not take the tool down with it
+	signal(SIGPIPE,SIG_IGN);
+
+	// Prepare I/O pipes
+	if (makePipe(enginepipe)==-1) {
+		errorNumber=ENGINECMDPIPE;
+		return true;
+	}
+	if (makePipe(enginerespipe)==-1) {
+		close(enginepipe[READ]);
+		close(enginepipe[WRITE]);
+		errorNumber=ENGINERESPIPE;
+		return true;
+	}
+
+	// Connect the pipes to stdin/stdout of the child only, our own
+	// std file descriptors are left alone
+	posix_spawn_file_actions_init(&actions);
+	rc=0;
+	if (posix_spawn_file_actions_adddup2(&actions,enginepipe[READ],0))
+		rc=ENGINEPIPEIN;
+	else if (posix_spawn_file_actions_adddup2(&actions,enginerespipe[WRITE],1))
+		rc=ENGINEPIPEOUT;
+	if (rc) {
+		posix_spawn_file_actions_destroy(&actions);
+		close(enginepipe[READ]);
+		close(enginepipe[WRITE]);
+		close(enginerespipe[READ]);
+		close(enginerespipe[WRITE]);
+		errorNumber=rc;
+		return true;
+	}
+
+	// Start the engine, relative to the working directory first, like
+	// _spawnv does, then through the PATH
+	rc=posix_spawn(&pid, args[0], &actions, 0, args, environ);
+	if (rc==ENOENT && !strchr(args[0],'/'))
+		rc=posix_spawnp(&pid, args[0], &actions, 0, args, environ);
+	posix_spawn_file_actions_destroy(&actions);
+
+	// Close the child ends of the pipes
+	close(enginerespipe[WRITE]);
+	close(enginepipe[READ]);
+
+	if (rc) {
+		close(enginepipe[WRITE]);
+		close(enginerespipe[READ]);
+		errorNumber=ENGINEPROCSTART;
+		return true;
+	}
+	engineid=pid;
+	if (affinityCount)
+		SetProcessAffinity(engineid,affinity,affinityCount);
+
+	// Connect I/O pipes properly
+	fromengine=enginerespipe[READ];
+	toengine=fdopen(enginepipe[WRITE],"w");
+	if (!toengine) {
+		close(enginepipe[WRITE]);
+		Kill();
+		ClosePipes();
+		errorNumber=ENGINEFDCMDPIPE;
+		return true;
+	}
+#endif
+
+	setbuf(toengine,0);
+
+	// from now on the engine output is collected by the reactor
+	inLength=0;
+	inClosed=false;
+	if (!Reactor::Get() || Reactor::Get()->Add(this,fromengine)) {
+		Kill();
+		ClosePipes();
+		errorNumber=ENGINENOREACTOR;
+		return true;
+	}
+	started=true;
+
+	errorNumber=ENGINEOK;
+	return false;
+}
+
+bool
+Engine::SetOption(const char* id, const char* value)
+{
+	errorNumber=ENGINENOOPT;
+	return true;
+}
+
+bool
+Engine::Synchronize(void)
+{
+	return false;
+}
+
+static void engineKill(void* param)
+{
+	// the engine did not terminate in time
+	((Engine*)param)->Kill();
+}
+
+bool
+Engine::WaitForStop(void)
+{
+	char buf[2048];
+	int killTimer;
+
+	if (toengine) {
+		fclose(toengine);
+		toengine=0;
+	}
+	// an engine that ignores quit is killed
+	killTimer=Reactor::Get()->AddTimer(STOPTIME,engineKill,this);
+	while (!ReadLine(buf,sizeof(buf)))
+		;
+	Reactor::Get()->CancelTimer(killTimer);
+	ClosePipes();
+	started=false;
+
+	errorNumber=ENGINEOK;
+	return false;
+}
+
+bool
+Engine::Kill(void)
+{
+	// the end of its output is noticed by the reactor as usual
+	if (engineid<=0) {
+		errorNumber=ENGINENOTSTARTED;
+		return true;
+	}
+#ifdef _WIN32
+	TerminateProcess((HANDLE)engineid,1);
+#else
+	kill((pid_t)engineid,SIGKILL);
+#endif
+	errorNumber=ENGINEOK;
+	return false;
+}
+
+void
+Engine::ClosePipes(void)
+{
+	// release everything of a terminated engine process
+	DisarmDeadline();
+	if (fromengine>=0)
+		Reactor::Get()->Remove(this);
+	if (toengine) {
+		fclose(toengine);
+		toengine=0;
+	}
+	if (fromengine>=0) {
+#ifdef _WIN32
+		_close(fromengine);
+#else
+		close(fromengine);
+#endif
+		fromengine=-1;
+	}
+	inLock.Lock();
+	inClosed=true;
+	inReady.Broadcast();
+	inLock.Unlock();
+	// reap the engine process
+	if (engineid>0)
+#ifdef _WIN32
+		_cwait(0,engineid,_WAIT_CHILD);
+#else
+		waitpid((pid_t)engineid,0,0);
+#endif
+	engineid=0;
+}
+
+bool
+Engine::HasTerminated(void)
+{
+	bool rv;
+
+	inLock.Lock();
+	rv=started && inClosed;
+	inLock.Unlock();
+	return rv;
+}
+
+bool
+Engine::Restart(void)
+{
+	// not from a handler, the reactor must be done with the old process
+	int killTimer;
+	bool rv;
+
+	if (started && !HasTerminated())
+		Kill();
+	ClosePipes();
+	inLock.Lock();
+	while (queueLength>0) {
+		free(queued[queueHead]);
+		queueHead=(queueHead+1)%MAXQUEUED;
+		queueLength--;
+	}
+	searching=false;
+	inLock.Unlock();
+	started=false;
+	stopSent=false;
+
+	// the new process starts with the engine's defaults
+	multiPV=1;
+	multiPVmin=1;
+	multiPVmax=1;
+	optionMultiPV=false;
+	optionPonder=false;
+	optionShowCurrline=false;
+	optionShowRefute=false;
+	optionAnalyzeMode=false;
+
+	// an engine that hangs while starting is killed as well
+	killTimer=Reactor::Get()->AddTimer(STARTTIME,engineKill,this);
+	rv=StartEngine();
+	Reactor::Get()->CancelTimer(killTimer);
+	return rv;
+}
+
+void
+Engine::SetWatchdog(int milliseconds)
+{
+	watchdog=milliseconds;
+}
+
+bool
+Engine::NextLine(char* buf, int size)
+{
+	// take the first complete line from the input buffer, called with
+	// inLock held. Returns true if there is no complete line.
+	char* eol=(char*)memchr(inBuffer,'\n',inLength);
+	int len;
+
+	if (!eol) {
+		if (inLength<inSize-1)
+			return true;
+		// overlong line, hand it over in parts
+		eol=inBuffer+inLength-1;
+	}
+	len=(int)(eol-inBuffer)+1;
+	if (len>size-1) {
+		memcpy(buf,inBuffer,size-1);
+		buf[size-1]='\0';
+	} else {
+		memcpy(buf,inBuffer,len);
+		buf[len]='\0';
+	}
+	inLength-=len;
+	memmove(inBuffer,inBuffer+len,inLength);
+	return false;
+}
+
+bool
+Engine::ReadLine(char* buf, int size)
+{
+	// blocking read of the next line, returns true when the engine has
+	// closed its output
+	inLock.Lock();
+	while (NextLine(buf,size)) {
+		if (inClosed) {
+			if (inLength>0) {
+				// last line without end of line
+				int len=inLength<size-1 ? inLength : size-1;
+
+				memcpy(buf,inBuffer,len);
+				buf[len]='\0';
+				inLength=0;
+				break;
+			}
+			inLock.Unlock();
+			*buf='\0';
+			errorNumber=ENGINECLOSED;
+			return true;
+		}
+		inReady.Wait(inLock);
+	}
+	inLock.Unlock();
+	return false;
+}
+
+bool
+Engine::ReadLine(char* buf, int size, int timeout)
+{
+	// as above, but gives up after timeout milliseconds with ENGINETIMEOUT
+	unsigned long long deadline=TimeMs()+timeout;
+	unsigned long long now;
+
+	inLock.Lock();
+	while (NextLine(buf,size)) {
+		if (inClosed) {
+			inLock.Unlock();
+			return ReadLine(buf,size);
+		}
+		now=TimeMs();
+		if (now>=deadline) {
+			inLock.Unlock();
+			*buf='\0';
+			errorNumber=ENGINETIMEOUT;
+			return true;
+		}
+		inReady.Wait(inLock,(int)(deadline-now));
+	}
+	inLock.Unlock();
+	return false;
+}
+
+void
+Engine::InputAvailable(const char* data, int n)
+{
+	// called from the reactor thread
+	char line[2048];
+
+	inLock.Lock();
+	if (inLength+n>inSize-1) {
+		// keep everything, nobody may be reading right now
+		char* grown;
+
+		while (inLength+n>inSize-1) inSize*=2;
+		grown=new char[inSize];
+		memcpy(grown,inBuffer,inLength);
+		delete[] inBuffer;
+		inBuffer=grown;
+	}
+	memcpy(inBuffer+inLength,data,n);
+	inLength+=n;
+
+	while (searching && !NextLine(line,sizeof(line))) {
+		int info;
+
+		inLock.Unlock();
+		info=ResponseLine(line);
+		if (info==searchInfoFinal) {
+			// the engine may already be used for the next search
+			return;
+		}
+		if (info==searchInfoInformative && runningStats.firstInfoUs<0)
+			runningStats.firstInfoUs=(long long)(TimeUs()-searchStartUs);
+		inLock.Lock();
+	}
+	inReady.Broadcast();
+	inLock.Unlock();
+}
+
+void
+Engine::InputClosed(void)
+{
+	// called from the reactor thread when the engine terminated
+	bool wasSearching;
+
+	inLock.Lock();
+	inClosed=true;
+	wasSearching=searching;
+	inReady.Broadcast();
+	inLock.Unlock();
+
+	if (wasSearching) {
+		errorNumber=ENGINECLOSED;
+		FinishSearch(0,0);
+	}
+}
+
+void engineDeadline(void* param)
+{
+	// the engine did not finish the search in time. It is asked to stop
+	// first, when it does not answer within GRACETIME it is killed, which
+	// ends the search through InputClosed.
+	Engine* engine=(Engine*)param;
+
+	engine->deadlineTimer=0;
+	if (!engine->searching)
+		return;
+	if (!engine->stopSent) {
+		engine->stopSent=true;
+		engine->SearchStop();
+		engine->deadlineTimer=Reactor::Get()->AddTimer(Engine::GRACETIME,engineDeadline,engine);
+	} else
+		engine->Kill();
+}
+
+void
+Engine::ArmDeadline(void)
+{
+	// the watchdog covers searches without a time limit
+	int ms=searchDeadline>0 ? searchDeadline : watchdog;
+
+	stopSent=false;
+	if (ms>0)
+		deadlineTimer=Reactor::Get()->AddTimer(ms,engineDeadline,this);
+}
+
+void
+Engine::DisarmDeadline(void)
+{
+	// a deadline that is just running may arm the grace timer, which is
+	// cancelled as well
+	while (deadlineTimer) {
+		int timer=deadlineTimer;
+
+		Reactor::Get()->CancelTimer(timer);
+		if (deadlineTimer==timer)
+			deadlineTimer=0;
+	}
+}
+
+void
+Engine::SetDoneHandler(searchDoneFunction dhf, void* param)
+{
+	doneHandler=dhf;
+	doneParam=param;
+}
+
+int
+Engine::GetBestMove(void)
+{
+	return bestMove;
+}
+
+int
+Engine::GetPonderMove(void)
+{
+	return ponderMove;
+}
+
+const char*
+Engine::GetBestMoveText(void)
+{
+	return bestMoveText;
+}
+
+int 
+Engine::GetError(void)
+{
+	return errorNumber;
+}
+
+const char*
+Engine::GetErrorStr()
+{
+	if (errorNumber>=0 && errorNumber<100)
+		return errorStrings[errorNumber];
+	else
+		return errorStrings[1];
+}
+
+bool
+Engine::StartSearch(void)
+{
+	// called before the search command is sent to the engine
+	inLock.Lock();
+	if (inClosed) {
+		inLock.Unlock();
+		errorNumber=ENGINECLOSED;
+		return true;
+	}
+	searching=true;
+	ResetStats();
+	inLock.Unlock();
+
+	ArmDeadline();
+	return false;
+}
+
+bool
+Engine::FinishSearch(int move, int pmove, const char* text)
+{
+	bool rv, sent;
+
+	DisarmDeadline();
+	lastFinishUs=TimeUs();
+	lastStats=runningStats;
+	lastStats.finalUs=(long long)(lastFinishUs-searchStartUs);
+	lastStats.elapsed=(int)(lastStats.finalUs/1000);
+	memcpy(lastTop,runningTop,sizeof(lastTop));
+	lastTopCount=runningTopCount;
+
+	// a queued search is started before anything else is done, the
+	// searches queued for an engine that terminated are lost
+	inLock.Lock();
+	while (inClosed && queueLength>0) {
+		free(queued[queueHead]);
+		queueHead=(queueHead+1)%MAXQUEUED;
+		queueLength--;
+	}
+	sent=SendQueued();
+	inLock.Unlock();
+
+	// report the final result
+	bestMove=move;
+	ponderMove=pmove;
+	snprintf(bestMoveText,sizeof(bestMoveText),"%.*s",text ? (int)strcspn(text," \t\r\n") : 0,text ? text : "");
+	rv=finHandler ? finHandler(move,pmove) : false;
+
+	// the engine is idle again, unless a search was queued meanwhile
+	inLock.Lock();
+	if (!sent && !SendQueued())
+		searching=false;
+	inLock.Unlock();
+	if (doneHandler) doneHandler(this,doneParam);
+	return rv;
+}
+
+bool
+Engine::ReportPV(int multi, int depth, int seldepth, int score, int time, long long nodes, int tbhits, int hashfull, const char* pv)
+{
+	// secondary lines of a multipv search are not the engine's choice
+	if (multi<=1)
+		runningStats.score=score;
+	ReportStats(multi,depth,seldepth,time,nodes);
+	if (multi<=MAXMULTIPV && pv) {
+		int k=multi<1 ? 0 : multi-1;
+		char move[6];
+		int n=(int)strcspn(pv," \t");
+
+		if (n>=4 && n<=5) {
+			memcpy(move,pv,n);
+			move[n]='\0';
+			while (runningTopCount<=k)
+				runningTop[runningTopCount++]=0;
+			runningTop[k]=ParseMove(move);
+		}
+	}
+	return pvHandler ? pvHandler(multi,depth,seldepth,score,time,nodes,tbhits,hashfull,pv) : false;
+}
+
+void
+Engine::ReportStats(int multi, int depth, int seldepth, int time, long long nodes)
+{
+	if (multi>1)
+		return;
+	if (depth>=0) runningStats.depth=depth;
+	if (seldepth>=0) runningStats.seldepth=seldepth;
+	if (nodes>=0) runningStats.nodes=nodes;
+	if (time>=0) runningStats.time=time;
+}
+
+void
+Engine::ResetStats(void)
+{
+	runningStats.depth=-1;
+	runningStats.seldepth=-1;
+	runningStats.score=0;
+	runningStats.nodes=-1;
+	runningStats.time=-1;
+	runningStats.elapsed=-1;
+	runningStats.firstInfoUs=-1;
+	runningStats.finalUs=-1;
+	searchStartUs=TimeUs();
+	runningStats.gapUs=lastFinishUs ? (long long)(searchStartUs-lastFinishUs) : -1;
+	runningTopCount=0;
+}
+
+void
+Engine::GetSearchStats(searchStats_t* stats)
+{
+	*stats=lastStats;
+}
+
+int
+Engine::GetTopMoves(int* moves, int size)
+{
+	int n=lastTopCount<size ? lastTopCount : size;
+
+	memcpy(moves,lastTop,n*sizeof(int));
+	return n;
+}
+
+bool
+Engine::SetMultiPV(int k)
+{
+	if (k==1)
+		return false;
+	errorNumber=ENGINENOTSUPP;
+	return true;
+}
+
+bool
+Engine::SetThreads(int n)
+{
+	errorNumber=ENGINENOTSUPP;
+	return true;
+}
+
+bool
+Engine::SetIsolation(int level)
+{
+	if (level==isolateNone)
+		return false;
+	errorNumber=ENGINENOTSUPP;
+	return true;
+}
+
+bool
+Engine::PrepareSearch(char* cmd, int size)
+{
+	errorNumber=ENGINENOTSUPP;
+	return true;
+}
+
+bool
+Engine::CanPipeline(void)
+{
+	// PrepareSearch must not change the state of the engine for this probe
+	char cmd[1024];
+
+	return !PrepareSearch(cmd,sizeof(cmd));
+}
+
+bool
+Engine::Send(const char* cmd)
+{
+	// one write for the whole command block
+	int fd=fileno(toengine);
+	int len=(int)strlen(cmd);
+
+	while (len>0) {
+#ifdef _WIN32
+		int n=_write(fd,cmd,len);
+#else
+		int n=(int)write(fd,cmd,len);
+
+		if (n<0 && errno==EINTR) continue;
+#endif
+		if (n<=0) {
+			errorNumber=ENGINECLOSED;
+			return true;
+		}
+		cmd+=n;
+		len-=n;
+	}
+	return false;
+}
+
+bool
+Engine::SendQueued(void)
+{
+	// called with inLock held
+	if (queueLength==0)
+		return false;
+
+	char* cmd=queued[queueHead];
+
+	queueHead=(queueHead+1)%MAXQUEUED;
+	queueLength--;
+	ResetStats();
+	Send(cmd);
+	free(cmd);
+	ArmDeadline();
+	return true;
+}
+
+bool
+Engine::QueueSearch(void)
+{
+	char cmd[1024];
+
+	if (!started) {
+		errorNumber=ENGINENOTSTARTED;
+		return true;
+	}
+	if (!finHandler) {
+		errorNumber=ENGINENOFRF;
+		return true;
+	}
+	if (PrepareSearch(cmd,sizeof(cmd)))
+		return true;
+
+	inLock.Lock();
+	if (inClosed) {
+		inLock.Unlock();
+		errorNumber=ENGINECLOSED;
+		return true;
+	}
+	if (!searching) {
+		// nothing to wait for
+		searching=true;
+		ResetStats();
+		inLock.Unlock();
+		ArmDeadline();
+		return Send(cmd);
+	}
+	if (queueLength==MAXQUEUED) {
+		inLock.Unlock();
+		errorNumber=ENGINEALREADYSEARCH;
+		return true;
+	}
+	queued[(queueHead+queueLength++)%MAXQUEUED]=strdup(cmd);
+	inLock.Unlock();
+
+	errorNumber=ENGINEOK;
+	return false;
+}
@@ -1,124 +1,269 @@
-// Engine.h
-//
-// Copyright (C) 2008-2013, ir. R.L. Pijl
-
-#ifndef __ENGINE_H
-#define __ENGINE_H
-
-#include <windows.h>
-
-DWORD WINAPI startResponseThread(LPVOID lpParam);
-
-class Engine
-{
-public:
-	Engine();
-	virtual ~Engine();
-
-	bool SetWorkingDir(const char* wdir);
-	bool SetExecName(const char* exec);
-	bool StartEngine(void);
-
-	virtual bool InitEngine(void)=0;
-	virtual bool SetOption(const char* id, const char* value);
-
-	virtual bool Synchronize(void);
-
-	virtual bool SetPosition(const char * fen)=0;
-
-	virtual bool SetSearchDepth(int depth)=0;
-	virtual bool SetSearchTime(int seconds)=0;
-	virtual bool SetSearchLevel(int moves, int seconds, int inc)=0;
-
-	virtual bool SetTimeRemaining(int milliseconds)=0;
-	virtual bool SetOppTimeRemaining (int milliseconds)=0;
-
-	typedef bool (*searchPVFunction)(int multi, int depth, int seldepth, int score, int time, int nodes, int tbhits, int hashfull, const char* pv);
-	typedef bool (*searchFRFunction)(int bestmove, int pondermove);
-	typedef bool (*searchCMFunction)(int currmovenr, int currmove, const char* currline);
-	typedef bool (*searchRefFunction)(int refmove, const char* refline);
-	typedef bool (*searchStrFunction)(const char* str);
-
-	// Search main function. Output is communicated back via handler functions.
-	// If a handler function is provided, the options needed to get output for it
-	// is automatically set as well (when supported by the engine).
-	// SearchFRFunction is compulsory as is marks the end of the search,
-	// rest may be null.
-
-	virtual bool Search(int mode, searchPVFunction, searchFRFunction, searchCMFunction, searchRefFunction, searchStrFunction, int move=0)=0;
-	virtual bool SearchStop(void)=0;
-
-	virtual bool Stop(void)=0;
-	bool WaitForStop(void);
-
-	int GetError(void);
-	const char* GetErrorStr();
-
-	friend DWORD WINAPI startResponseThread(LPVOID lpParam);
-
-	typedef enum {
-		ENGINEOK=0,	ENGINEOTHERR, ENGINENODIR, ENGINENOMEM, ENGINENONAME,
-		ENGINECMDPIPE, ENGINERESPIPE, ENGINEPIPEIN, ENGINEPIPEOUT, ENGINESTDIN,
-		ENGINESTDOUT, ENGINEPROCSTART, ENGINEFDCMDPIPE, ENGINEFDRESPIPE, ENGINENOTERM,
-		ENGINECOPYPROT, ENGINENOPOS, ENGINEALREADYSTARTED, ENGINENOTSTARTED, ENGINENOSEARCH,
-		ENGINEALREADYSEARCH, ENGINENORESPTHREAD, ENGINENOFRF, ENGINENOTSUPP, ENGINEILLPOS,
-		ENGINENOOPT
-	} err_t;
-
-	typedef enum {
-		searchMove=0,
-		searchAnalyse,
-		searchPonder
-	} mode_t;
-
-	typedef enum {
-		searchInfoNone=0,
-		searchInfoInformative,
-		searchInfoFinal
-	} info_t;
-
-protected:
-
-	FILE* toengine, *fromengine;
-	int errorNumber;
-	bool started;
-	bool searching;
-
-	bool optionPonder;
-	bool ponderMode;
-
-	bool optionMultiPV;
-	int multiPV;
-	int multiPVmin;
-	int multiPVmax;
-
-	bool optionShowCurrline;
-	bool showCurrline;
-
-	bool optionShowRefute;
-	bool showRefutation;
-
-	bool optionAnalyzeMode;
-
-	searchPVFunction pvHandler;
-	searchFRFunction finHandler;
-	searchCMFunction cmHandler;
-	searchRefFunction refHandler;
-	searchStrFunction strHandler;
-
-	virtual bool ResponseThread(void)=0;
-
-private:
-
-	char* engineWorkingDir;
-	char* engineExecName;
-
-	int enginepipe[2];
-	int enginerespipe[2];
-	intptr_t engineid;
-
-	static const char *errorStrings[100];
-	enum { READ=0, WRITE };
-};
-
+// Engine.h
+//
+// Copyright (C) 2008-2013, ir. R.L. Pijl
+
+#ifndef __ENGINE_H
+#define __ENGINE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "platform.h"
+
+class Engine
+{
+public:
+	Engine();
+	virtual ~Engine();
+
+	bool SetWorkingDir(const char* wdir);
+	bool SetExecName(const char* exec);
+	const char* GetExecName(void);
+	bool StartEngine(void);
+
+	// StartEngine is StartProcess followed by InitEngine. The processes of
+	// a pool are started one by one, their initialisation may overlap.
+	bool StartProcess(void);
+
+	// Processors the engine process is restricted to, also after a
+	// restart. None (the default) leaves it to the operating system.
+	enum { MAXCORES=64 };
+	void SetAffinity(const int* cores, int n);
+
+	virtual bool InitEngine(void)=0;
+	virtual bool SetOption(const char* id, const char* value);
+
+	virtual bool Synchronize(void);
+
+	virtual bool SetPosition(const char * fen)=0;
+
+	virtual bool SetSearchDepth(int depth)=0;
+	virtual bool SetSearchTime(int seconds)=0;
+	virtual bool SetSearchTimeMs(int milliseconds)=0;
+	virtual bool SetSearchNodes(long long nodes)=0;
+	virtual bool SetSearchLevel(int moves, int seconds, int inc)=0;
+
+	// Number of principal variations searched, 1 for a normal search. Not all
+	// engines support it.
+	enum { MAXMULTIPV=8 };
+	virtual bool SetMultiPV(int k);
+
+	// Number of search threads, for engines that announce it. Others keep
+	// their default and report ENGINENOTSUPP.
+	virtual bool SetThreads(int n);
+
+	// How much of the previous search an engine may remember at the start
+	// of the next one
+	typedef enum {
+		isolateNone=0,
+		isolateNewGame,
+		isolateClearHash
+	} isolation_t;
+	virtual bool SetIsolation(int level);
+
+	virtual bool SetTimeRemaining(int milliseconds)=0;
+	virtual bool SetOppTimeRemaining (int milliseconds)=0;
+
+	typedef bool (*searchPVFunction)(int multi, int depth, int seldepth, int score, int time, long long nodes, int tbhits, int hashfull, const char* pv);
+	typedef bool (*searchFRFunction)(int bestmove, int pondermove);
+	typedef bool (*searchCMFunction)(int currmovenr, int currmove, const char* currline);
+	typedef bool (*searchRefFunction)(int refmove, const char* refline);
+	typedef bool (*searchStrFunction)(const char* str);
+	typedef void (*searchDoneFunction)(Engine* engine, void* param);
+
+	// Search main function. Output is communicated back via handler functions.
+	// If a handler function is provided, the options needed to get output for it
+	// is automatically set as well (when supported by the engine).
+	// SearchFRFunction is compulsory as is marks the end of the search,
+	// rest may be null.
+
+	virtual bool Search(int mode, searchPVFunction, searchFRFunction, searchCMFunction, searchRefFunction, searchStrFunction, int move=0)=0;
+	virtual bool SearchStop(void)=0;
+
+	// Pipelined search: the commands for the current position and search
+	// settings are prepared now and sent in a single write the moment the
+	// running search ends, reusing its handlers. Starts at once when idle.
+	bool QueueSearch(void);
+	virtual bool CanPipeline(void);
+
+	virtual bool Stop(void)=0;
+	bool WaitForStop(void);
+
+	// Supervision of the engine process. A search that does not end at its
+	// deadline is stopped, and the engine is killed when it does not answer
+	// the stop within GRACETIME. The watchdog is the deadline of searches
+	// without a time limit, 0 for none. A terminated engine is started again
+	// with Restart, its options and search settings have to be set again.
+	void SetWatchdog(int milliseconds);
+	bool HasTerminated(void);
+	bool Kill(void);
+	bool Restart(void);
+
+	// Called after the final response of every search, so a pool of engines
+	// can find out which engine became idle. The last result remains
+	// available through GetBestMove and GetPonderMove.
+	void SetDoneHandler(searchDoneFunction dhf, void* param);
+	int GetBestMove(void);
+	int GetPonderMove(void);
+
+	// The best move as the engine wrote it, "" if it did not send one
+	const char* GetBestMoveText(void);
+
+	// Statistics of the last search, taken from its last (first multipv) pv.
+	// Values the engine did not report are -1; elapsed is measured here from
+	// the moment the search was sent until its final response. The timings
+	// in microseconds are measured here as well, for profiling the tool.
+	typedef struct {
+		int depth;
+		int seldepth;
+		int score;
+		long long nodes;
+		int time;
+		int elapsed;
+		long long firstInfoUs;	// search sent until the first info, -1 if none
+		long long finalUs;		// search sent until the final response
+		long long gapUs;		// previous final response until this search was sent
+	} searchStats_t;
+	void GetSearchStats(searchStats_t* stats);
+
+	// The first move of every pv of the last search in multipv order, from
+	// the last pv reported for each. Returns the number of moves.
+	int GetTopMoves(int* moves, int size);
+
+	int GetError(void);
+	const char* GetErrorStr();
+
+	friend class Reactor;
+
+	typedef enum {
+		ENGINEOK=0,	ENGINEOTHERR, ENGINENODIR, ENGINENOMEM, ENGINENONAME,
+		ENGINECMDPIPE, ENGINERESPIPE, ENGINEPIPEIN, ENGINEPIPEOUT, ENGINESTDIN,
+		ENGINESTDOUT, ENGINEPROCSTART, ENGINEFDCMDPIPE, ENGINEFDRESPIPE, ENGINENOTERM,
+		ENGINECOPYPROT, ENGINENOPOS, ENGINEALREADYSTARTED, ENGINENOTSTARTED, ENGINENOSEARCH,
+		ENGINEALREADYSEARCH, ENGINENORESPTHREAD, ENGINENOFRF, ENGINENOTSUPP, ENGINEILLPOS,
+		ENGINENOOPT, ENGINENOREACTOR, ENGINECLOSED, ENGINETIMEOUT
+	} err_t;
+
+	typedef enum {
+		searchMove=0,
+		searchAnalyse,
+		searchPonder
+	} mode_t;
+
+	typedef enum {
+		searchInfoNone=0,
+		searchInfoInformative,
+		searchInfoFinal
+	} info_t;
+
+protected:
+
+	FILE* toengine;
+	int fromengine;
+	int errorNumber;
+	bool started;
+	bool searching;
+
+	bool optionPonder;
+	bool ponderMode;
+
+	bool optionMultiPV;
+	int multiPV;
+	int multiPVmin;
+	int multiPVmax;
+
+	bool optionShowCurrline;
+	bool showCurrline;
+
+	bool optionShowRefute;
+	bool showRefutation;
+
+	bool optionAnalyzeMode;
+
+	searchPVFunction pvHandler;
+	searchFRFunction finHandler;
+	searchCMFunction cmHandler;
+	searchRefFunction refHandler;
+	searchStrFunction strHandler;
+	searchDoneFunction doneHandler;
+	void* doneParam;
+
+	int bestMove;
+	int ponderMove;
+	char bestMoveText[16];
+
+	// Deadline after which a running search is stopped, 0 for none. Quit
+	// and a restart are given STOPTIME and STARTTIME before the engine is
+	// killed.
+	enum { GRACETIME=1000, STOPTIME=2000, STARTTIME=30000 };
+	int searchDeadline;
+
+	// Engine output is collected by the reactor. Outside a search the lines
+	// are read with ReadLine, during a search they are passed to
+	// ResponseLine, which returns an info_t.
+	bool ReadLine(char* buf, int size);
+	bool ReadLine(char* buf, int size, int timeout);
+	virtual int ResponseLine(char* line)=0;
+	bool StartSearch(void);
+	bool FinishSearch(int move, int pmove, const char* text=0);
+
+	// Engines report every pv through this, it keeps the statistics and
+	// calls the pv handler. Progress reports without a pv go to ReportStats,
+	// fields they do not have are -1 and keep their last value.
+	bool ReportPV(int multi, int depth, int seldepth, int score, int time, long long nodes, int tbhits, int hashfull, const char* pv);
+	void ReportStats(int multi, int depth, int seldepth, int time, long long nodes);
+
+	// Commands that start a search with the current settings
+	virtual bool PrepareSearch(char* cmd, int size);
+	bool Send(const char* cmd);
+
+private:
+
+	char* engineWorkingDir;
+	char* engineExecName;
+	int affinity[MAXCORES];
+	int affinityCount;
+
+	int enginepipe[2];
+	int enginerespipe[2];
+	intptr_t engineid;
+
+	char* inBuffer;
+	int inLength;
+	int inSize;
+	bool inClosed;
+	Mutex inLock;
+	Condition inReady;
+	int deadlineTimer;
+	int watchdog;
+	bool stopSent;
+	void ArmDeadline(void);
+	void DisarmDeadline(void);
+	void ClosePipes(void);
+
+	enum { MAXQUEUED=4 };
+	char* queued[MAXQUEUED];
+	int queueHead;
+	int queueLength;
+	bool SendQueued(void);
+
+	searchStats_t runningStats;
+	searchStats_t lastStats;
+	int runningTop[MAXMULTIPV];
+	int lastTop[MAXMULTIPV];
+	int runningTopCount;
+	int lastTopCount;
+	unsigned long long searchStartUs;
+	unsigned long long lastFinishUs;
+	void ResetStats(void);
+
+	bool NextLine(char* buf, int size);
+	void InputAvailable(const char* data, int n);
+	void InputClosed(void);
+
+	friend void engineDeadline(void* param);
+
+	static const char *errorStrings[100];
+	enum { READ=0, WRITE };
+};
+
 #endif
\ No newline at end of file
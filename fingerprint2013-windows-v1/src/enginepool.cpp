@@ -0,0 +1,806 @@
+// EnginePool.cpp
+//
+// Copyright (C) 2008-2013, ir. R.L. Pijl
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "enginepool.h"
+#include "engineuci.h"
+#include "enginewb.h"
+#include "position.h"
+
+static bool poolFinHandler(int, int)
+{
+	// results are collected by the done handler
+	return false;
+}
+
+void poolDoneHandler(Engine* engine, void* param)
+{
+	// called from the response thread of the engine
+	((EnginePool*)param)->EngineDone(engine);
+}
+
+int poolInitThread(void* param)
+{
+	EnginePool::init_t* init=(EnginePool::init_t*)param;
+	EnginePool* pool=init->pool;
+	bool failed=init->engine->InitEngine();
+
+	pool->lock.Lock();
+	init->failed=failed;
+	pool->initRunning--;
+	pool->idle.Signal();
+	pool->lock.Unlock();
+	return 0;
+}
+
+EnginePool::EnginePool()
+{
+	engines=0;
+	engineType=poolUCI;
+	affinityCount=0;
+	engineJob=0;
+	engineLoad=0;
+	engineDepth=0;
+	engineFailed=0;
+	failures=0;
+	initRunning=0;
+	illegalMoves=0;
+	failedPositions=0;
+	count=0;
+	freeSlots=0;
+	slots=0;
+	pipelined=false;
+	jobs=0;
+	jobSize=0;
+	inputId=0;
+	outputId=0;
+	pending=0;
+	pendingCount=0;
+	optionIds=0;
+	optionValues=0;
+	optionCount=0;
+	limitType=limitNone;
+	limitValue=0;
+	multiPV=1;
+	threads=0;
+	isolation=Engine::isolateNone;
+	watchdog=0;
+	resultHandler=0;
+	resultParam=0;
+	errorEngine=0;
+}
+
+EnginePool::~EnginePool()
+{
+	for (int i=0; i<count; i++)
+		delete engines[i];
+	if (engines)
+		delete[] engines;
+	if (engineJob)
+		delete[] engineJob;
+	if (engineLoad)
+		delete[] engineLoad;
+	if (engineDepth)
+		delete[] engineDepth;
+	if (engineFailed)
+		delete[] engineFailed;
+	if (pending)
+		delete[] pending;
+	for (int i=0; i<optionCount; i++) {
+		free(optionIds[i]);
+		if (optionValues[i]) free(optionValues[i]);
+	}
+	if (optionIds)
+		free(optionIds);
+	if (optionValues)
+		free(optionValues);
+	if (jobs) {
+		for (int i=0; i<jobSize; i++)
+			if (jobs[i].epd) free(jobs[i].epd);
+		delete[] jobs;
+	}
+}
+
+bool
+EnginePool::StartEngines(int type, const char* exec, const char* wdir, int n)
+{
+	init_t* init;
+
+	if (n<1) n=1;
+
+	engineType=type;
+	engines=new Engine*[n];
+	engineJob=new int[n*MAXDEPTH];
+	engineLoad=new int[n];
+	engineDepth=new int[n];
+	engineFailed=new bool[n];
+	pending=new int[n*MAXDEPTH+1];
+
+	for (count=0; count<n; count++) {
+		Engine* engine;
+
+		if (type==poolUCI)
+			engine=new UCIEngine;
+		else
+			engine=new WBEngine;
+		engines[count]=engine;
+		engineLoad[count]=0;
+		engineDepth[count]=1;
+		engineFailed[count]=false;
+
+		engine->SetAffinity(affinity,affinityCount);
+		if (engine->SetExecName(exec) || (wdir && engine->SetWorkingDir(wdir))
+			|| engine->StartProcess()) {
+			errorEngine=engine;
+			count++;
+			return true;
+		}
+		engine->SetDoneHandler(poolDoneHandler,this);
+	}
+
+	// waiting for the uciok or the features of one engine at a time would
+	// make the startup time grow with the number of engines
+	init=new init_t[count];
+	lock.Lock();
+	initRunning=count;
+	lock.Unlock();
+	for (int i=0; i<count; i++) {
+		init[i].pool=this;
+		init[i].engine=engines[i];
+		init[i].failed=false;
+		if (StartThread(poolInitThread,&init[i]))
+			poolInitThread(&init[i]);
+	}
+	lock.Lock();
+	while (initRunning>0)
+		idle.Wait(lock);
+	lock.Unlock();
+	for (int i=0; i<count; i++) {
+		if (init[i].failed) {
+			errorEngine=engines[i];
+			delete[] init;
+			return true;
+		}
+	}
+	delete[] init;
+	SetPipelined(pipelined);
+
+	// room for the results that may arrive out of order
+	jobSize=2*MAXDEPTH*count;
+	jobs=new job_t[jobSize];
+	memset(jobs,0,jobSize*sizeof(job_t));
+
+	errorEngine=0;
+	return false;
+}
+
+void
+EnginePool::SetAffinity(const int* cores, int n)
+{
+	affinityCount=n<Engine::MAXCORES ? n : Engine::MAXCORES;
+	memcpy(affinity,cores,affinityCount*sizeof(int));
+}
+
+bool
+EnginePool::SetOption(const char* id, const char* value)
+{
+	optionIds=(char**)realloc(optionIds,(optionCount+1)*sizeof(char*));
+	optionValues=(char**)realloc(optionValues,(optionCount+1)*sizeof(char*));
+	optionIds[optionCount]=strdup(id);
+	optionValues[optionCount]=value ? strdup(value) : 0;
+	optionCount++;
+
+	for (int i=0; i<count; i++) {
+		if (engines[i]->SetOption(id,value)) {
+			errorEngine=engines[i];
+			return true;
+		}
+	}
+	return false;
+}
+
+bool
+EnginePool::Synchronize(void)
+{
+	for (int i=0; i<count; i++) {
+		if (engines[i]->Synchronize()) {
+			errorEngine=engines[i];
+			return true;
+		}
+	}
+	return false;
+}
+
+bool
+EnginePool::SetSearchTime(int seconds)
+{
+	limitType=limitSeconds;
+	limitValue=seconds;
+	for (int i=0; i<count; i++) {
+		if (engines[i]->SetSearchTime(seconds)) {
+			errorEngine=engines[i];
+			return true;
+		}
+	}
+	return false;
+}
+
+bool
+EnginePool::SetSearchTimeMs(int milliseconds)
+{
+	limitType=limitMs;
+	limitValue=milliseconds;
+	for (int i=0; i<count; i++) {
+		if (engines[i]->SetSearchTimeMs(milliseconds)) {
+			errorEngine=engines[i];
+			return true;
+		}
+	}
+	return false;
+}
+
+bool
+EnginePool::SetSearchNodes(long long nodes)
+{
+	limitType=limitNodes;
+	limitValue=nodes;
+	for (int i=0; i<count; i++) {
+		if (engines[i]->SetSearchNodes(nodes)) {
+			errorEngine=engines[i];
+			return true;
+		}
+	}
+	return false;
+}
+
+bool
+EnginePool::SetSearchDepth(int depth)
+{
+	limitType=limitDepth;
+	limitValue=depth;
+	for (int i=0; i<count; i++) {
+		if (engines[i]->SetSearchDepth(depth)) {
+			errorEngine=engines[i];
+			return true;
+		}
+	}
+	return false;
+}
+
+bool
+EnginePool::SetIsolation(int level)
+{
+	isolation=level;
+	for (int i=0; i<count; i++) {
+		if (engines[i]->SetIsolation(level)) {
+			errorEngine=engines[i];
+			return true;
+		}
+	}
+	return false;
+}
+
+bool
+EnginePool::SetMultiPV(int k)
+{
+	multiPV=k;
+	for (int i=0; i<count; i++) {
+		if (engines[i]->SetMultiPV(k)) {
+			errorEngine=engines[i];
+			return true;
+		}
+	}
+	return false;
+}
+
+bool
+EnginePool::SetThreads(int n)
+{
+	for (int i=0; i<count; i++) {
+		if (engines[i]->SetThreads(n)) {
+			errorEngine=engines[i];
+			return true;
+		}
+	}
+	threads=n;
+	return false;
+}
+
+bool
+EnginePool::SetWatchdog(int milliseconds)
+{
+	watchdog=milliseconds;
+	for (int i=0; i<count; i++)
+		engines[i]->SetWatchdog(milliseconds);
+	return false;
+}
+
+bool
+EnginePool::ConfigureEngine(Engine* engine)
+{
+	// the settings in the order they were made on the whole pool
+	bool rv=false;
+
+	for (int i=0; i<optionCount && !rv; i++)
+		rv=engine->SetOption(optionIds[i],optionValues[i]);
+	if (threads)
+		rv=rv || engine->SetThreads(threads);
+	rv=rv || engine->Synchronize();
+	switch (limitType) {
+	case limitSeconds:
+		rv=rv || engine->SetSearchTime((int)limitValue);
+		break;
+	case limitMs:
+		rv=rv || engine->SetSearchTimeMs((int)limitValue);
+		break;
+	case limitNodes:
+		rv=rv || engine->SetSearchNodes(limitValue);
+		break;
+	case limitDepth:
+		rv=rv || engine->SetSearchDepth((int)limitValue);
+		break;
+	}
+	rv=rv || engine->SetMultiPV(multiPV) || engine->SetIsolation(isolation);
+	engine->SetWatchdog(watchdog);
+	return rv;
+}
+
+void
+EnginePool::SetResultHandler(resultFunction rf, void* param)
+{
+	resultHandler=rf;
+	resultParam=param;
+}
+
+void
+EnginePool::SetPipelined(bool p)
+{
+	// only to be changed while all engines are idle
+	pipelined=p;
+	slots=0;
+	for (int i=0; i<count; i++) {
+		engineDepth[i]=(pipelined && engines[i]->CanPipeline()) ? MAXDEPTH : 1;
+		slots+=engineDepth[i];
+	}
+	freeSlots=slots;
+}
+
+EnginePool::job_t*
+EnginePool::Job(int id)
+{
+	return &jobs[id%jobSize];
+}
+
+bool
+EnginePool::GrowJobs(void)
+{
+	// called with the lock held, the ring is full
+	job_t* grown=new job_t[2*jobSize];
+
+	memset(grown,0,2*jobSize*sizeof(job_t));
+	for (int id=outputId; id<inputId; id++)
+		grown[id%(2*jobSize)]=*Job(id);
+	delete[] jobs;
+	jobs=grown;
+	jobSize*=2;
+	return false;
+}
+
+bool
+EnginePool::DeliverResults(void)
+{
+	// report finished results in input order
+	lock.Lock();
+	while (outputId<inputId && Job(outputId)->done) {
+		job_t job=*Job(outputId);
+		result_t result;
+
+		Job(outputId)->epd=0;
+		Job(outputId)->done=false;
+		result.id=outputId++;
+		lock.Unlock();
+
+		result.epd=job.epd;
+		result.bestMove=job.bestMove;
+		result.ponderMove=job.ponderMove;
+		result.stats=job.stats;
+		result.topCount=job.topCount;
+		result.failed=job.failed;
+		memcpy(result.topMoves,job.topMoves,sizeof(result.topMoves));
+		if (resultHandler) resultHandler(&result,resultParam);
+		free(job.epd);
+
+		lock.Lock();
+	}
+	lock.Unlock();
+	return false;
+}
+
+void
+EnginePool::EngineDone(Engine* engine)
+{
+	lock.Lock();
+	for (int i=0; i<count; i++) {
+		if (engines[i]==engine) {
+			// searches end in the order they were handed to the engine
+			int* ej=&engineJob[i*MAXDEPTH];
+			job_t* job=Job(ej[0]);
+
+			if (engine->HasTerminated()) {
+				// the jobs stay with the engine until it is restarted
+				if (!engineFailed[i]) {
+					engineFailed[i]=true;
+					failures++;
+				}
+				break;
+			}
+			job->bestMove=engine->GetBestMove();
+			job->ponderMove=engine->GetPonderMove();
+			engine->GetSearchStats(&job->stats);
+			job->topCount=engine->GetTopMoves(job->topMoves,Engine::MAXMULTIPV);
+			ValidateMoves(job,engine->GetBestMoveText());
+			job->done=true;
+			for (int k=1; k<engineLoad[i]; k++)
+				ej[k-1]=ej[k];
+			engineLoad[i]--;
+			freeSlots++;
+			break;
+		}
+	}
+	idle.Signal();
+	lock.Unlock();
+}
+
+void
+EnginePool::ValidateMoves(job_t* job, const char* text)
+{
+	// The best move is read again from the engine's text, which may be SAN
+	// or O-O, and kept only when it is legal. A position the tool cannot
+	// decode keeps the move as it is.
+	Position position;
+
+	if (position.SetFEN(job->epd))
+		return;
+	job->bestMove=*text ? position.ParseMove(text) : 0;
+	if (!job->bestMove && *text && strcmp(text,"0000") && strcmp(text,"(none)") && strcmp(text,"@@@@"))
+		illegalMoves++;
+	for (int k=0; k<job->topCount; k++)
+		if (!position.IsLegal(job->topMoves[k]))
+			job->topMoves[k]=0;
+}
+
+int
+EnginePool::GetFailedPositions(void)
+{
+	int n;
+
+	lock.Lock();
+	n=failedPositions;
+	lock.Unlock();
+	return n;
+}
+
+int
+EnginePool::GetIllegalMoves(void)
+{
+	int n;
+
+	lock.Lock();
+	n=illegalMoves;
+	lock.Unlock();
+	return n;
+}
+
+bool
+EnginePool::GetSettingsDigest(unsigned char digest[Sha256::DIGESTSIZE])
+{
+	Sha256 sha;
+	unsigned char exec[Sha256::DIGESTSIZE];
+	char settings[128];
+	char *name, *path;
+	const char* args;
+	int* order;
+	bool rv;
+
+	if (!count)
+		return true;
+
+	// the executable the engine was started from, found as StartProcess
+	// finds it, followed by its arguments
+	args=engines[0]->GetExecName();
+	args+=strspn(args," \t");
+	name=strdup(args);
+	name[strcspn(name," \t")]='\0';
+	args+=strlen(name);
+	path=FindExecutable(name);
+	free(name);
+	rv=!path || Sha256::HashFile(path,exec);
+	free(path);
+	if (rv)
+		return true;
+	sha.Update(exec,sizeof(exec));
+	sha.Update(args,strlen(args)+1);
+
+	snprintf(settings,sizeof(settings),"%d %d %lld %d %d",engineType,limitType,limitValue,multiPV,isolation);
+	sha.Update(settings,strlen(settings)+1);
+
+	// a stable sort keeps the order of an option that was set twice
+	order=new int[optionCount];
+	for (int i=0; i<optionCount; i++) {
+		int j=i;
+
+		while (j>0 && strcmp(optionIds[order[j-1]],optionIds[i])>0) {
+			order[j]=order[j-1];
+			j--;
+		}
+		order[j]=i;
+	}
+	for (int i=0; i<optionCount; i++) {
+		const char* value=optionValues[order[i]];
+
+		sha.Update(optionIds[order[i]],strlen(optionIds[order[i]])+1);
+		sha.Update(value ? value : "",strlen(value ? value : "")+1);
+	}
+	delete[] order;
+
+	sha.Final(digest);
+	return false;
+}
+
+bool
+EnginePool::Analyse(const char* epd)
+{
+	return Analyse(epd,(int)strlen(epd));
+}
+
+bool
+EnginePool::Analyse(const char* epd, int length)
+{
+	int id;
+	job_t* job;
+	char* position;
+
+	// the position need not be terminated, the job keeps its own copy
+	position=(char*)malloc(length+1);
+	memcpy(position,epd,length);
+	position[length]='\0';
+
+	lock.Lock();
+	if (inputId-outputId==jobSize)
+		GrowJobs();
+	id=inputId++;
+	job=Job(id);
+	job->epd=position;
+	job->retries=0;
+	job->failed=false;
+	job->done=false;
+	pending[pendingCount++]=id;
+	lock.Unlock();
+
+	return Submit();
+}
+
+bool
+EnginePool::Submit(void)
+{
+	// hand the pending jobs to the engines, waiting for one to be idle.
+	// Engines that terminated meanwhile are restarted first, which puts
+	// their jobs in front.
+	int i, k, id;
+	bool rv=false, failed;
+	const char* position;
+
+	lock.Lock();
+	for (;;) {
+		if (failures>0) {
+			lock.Unlock();
+			if (RecoverEngines())
+				rv=true;
+			lock.Lock();
+			continue;
+		}
+		if (pendingCount==0)
+			break;
+		if (slots==0) {
+			// no engine left
+			while (pendingCount>0)
+				FailJob(pending[--pendingCount]);
+			rv=true;
+			break;
+		}
+		if (freeSlots==0) {
+			idle.Wait(lock);
+			continue;
+		}
+		lock.Unlock();
+
+		DeliverResults();
+
+		// prefer an idle engine over queueing behind a running search
+		lock.Lock();
+		k=-1;
+		for (i=0; i<count; i++)
+			if (!engineFailed[i] && engineLoad[i]<engineDepth[i] && (k<0 || engineLoad[i]<engineLoad[k]))
+				k=i;
+		if (k<0) {
+			// the free slots are those of a terminated engine
+			if (failures==0)
+				idle.Wait(lock);
+			continue;
+		}
+		i=k;
+		id=pending[0];
+		memmove(pending,pending+1,--pendingCount*sizeof(int));
+		position=Job(id)->epd;
+		engineJob[i*MAXDEPTH+engineLoad[i]++]=id;
+		freeSlots--;
+		k=engineLoad[i];
+		lock.Unlock();
+
+		if (k==1)
+			failed=engines[i]->SetPosition(position)
+				|| engines[i]->Search(Engine::searchMove, 0, poolFinHandler, 0, 0, 0);
+		else
+			failed=engines[i]->SetPosition(position) || engines[i]->QueueSearch();
+
+		lock.Lock();
+		if (failed) {
+			if (engines[i]->HasTerminated()) {
+				// searched again after the restart
+				if (!engineFailed[i]) {
+					engineFailed[i]=true;
+					failures++;
+				}
+			} else {
+				errorEngine=engines[i];
+				FailJob(id);
+				engineLoad[i]--;
+				freeSlots++;
+				rv=true;
+			}
+		}
+	}
+	lock.Unlock();
+	return rv;
+}
+
+void
+EnginePool::FailJob(int id)
+{
+	// report the position without a move rather than stalling the output,
+	// called with the lock held
+	job_t* job=Job(id);
+
+	job->bestMove=0;
+	job->ponderMove=0;
+	job->stats.depth=job->stats.seldepth=-1;
+	job->stats.score=0;
+	job->stats.nodes=-1;
+	job->stats.time=job->stats.elapsed=-1;
+	job->stats.firstInfoUs=job->stats.finalUs=job->stats.gapUs=-1;
+	job->topCount=0;
+	job->failed=true;
+	job->done=true;
+	failedPositions++;
+}
+
+bool
+EnginePool::RecoverEngines(void)
+{
+	// restart the engines that terminated, from the thread calling
+	// Analyse/WaitForAll. Returns true when an engine could not be
+	// restarted, the pool continues without it.
+	int ids[MAXDEPTH], retry[MAXDEPTH];
+	int i, k, n, r;
+	bool rv=false, failed;
+
+	for (i=0; i<count; i++) {
+		lock.Lock();
+		failed=engineFailed[i];
+		lock.Unlock();
+		if (!failed)
+			continue;
+
+		// no handler of the old process runs after this
+		failed=engines[i]->Restart() || ConfigureEngine(engines[i]);
+
+		lock.Lock();
+		engineFailed[i]=false;
+		failures--;
+		n=engineLoad[i];
+		memcpy(ids,&engineJob[i*MAXDEPTH],n*sizeof(int));
+		engineLoad[i]=0;
+		freeSlots+=n;
+		if (failed) {
+			errorEngine=engines[i];
+			freeSlots-=engineDepth[i];
+			slots-=engineDepth[i];
+			engineDepth[i]=0;
+			rv=true;
+		}
+
+		// a position that keeps killing the engine is given up
+		for (k=r=0; k<n; k++) {
+			if (++Job(ids[k])->retries>MAXRETRIES)
+				FailJob(ids[k]);
+			else
+				retry[r++]=ids[k];
+		}
+		memmove(pending+r,pending,pendingCount*sizeof(int));
+		memcpy(pending,retry,r*sizeof(int));
+		pendingCount+=r;
+		lock.Unlock();
+	}
+	return rv;
+}
+
+bool
+EnginePool::WaitForAll(void)
+{
+	lock.Lock();
+	while (freeSlots<slots || failures>0 || pendingCount>0) {
+		if (failures>0 || pendingCount>0) {
+			lock.Unlock();
+			Submit();
+			lock.Lock();
+			continue;
+		}
+		idle.Wait(lock);
+	}
+	lock.Unlock();
+
+	return DeliverResults();
+}
+
+bool
+EnginePool::Stop(void)
+{
+	bool rv=false;
+
+	for (int i=0; i<count; i++) {
+		if (engineDepth[i]==0) {
+			// an engine that could not be restarted need not quit
+			engines[i]->Kill();
+			engines[i]->WaitForStop();
+			continue;
+		}
+		if (engines[i]->Stop()) {
+			errorEngine=engines[i];
+			rv=true;
+		}
+	}
+	return rv;
+}
+
+int
+EnginePool::GetCount(void)
+{
+	return count;
+}
+
+Engine*
+EnginePool::GetEngine(int i)
+{
+	if (i<0 || i>=count) return 0;
+	return engines[i];
+}
+
+int
+EnginePool::GetError(void)
+{
+	if (errorEngine)
+		return errorEngine->GetError();
+	return Engine::ENGINEOK;
+}
+
+const char*
+EnginePool::GetErrorStr()
+{
+	if (errorEngine)
+		return errorEngine->GetErrorStr();
+	return "Ok";
+}
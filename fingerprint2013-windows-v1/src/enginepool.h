@@ -0,0 +1,184 @@
+// EnginePool.h
+//
+// Copyright (C) 2008-2013, ir. R.L. Pijl
+
+#ifndef __ENGINEPOOL_H
+#define __ENGINEPOOL_H
+
+#include "engine.h"
+#include "sha256.h"
+
+class EnginePool
+{
+public:
+	EnginePool();
+	virtual ~EnginePool();
+
+	typedef enum {
+		poolUCI=0,
+		poolWB
+	} type_t;
+
+	typedef struct {
+		int id;
+		const char* epd;
+		int bestMove;
+		int ponderMove;
+		Engine::searchStats_t stats;
+		int topCount;		// multipv moves, best first
+		int topMoves[Engine::MAXMULTIPV];
+		bool failed;		// the engine could not search the position
+	} result_t;
+
+	typedef bool (*resultFunction)(const result_t* result, void* param);
+
+	// Start count single-threaded instances of the same engine. The
+	// processes are started one by one, then initialised in parallel.
+	bool StartEngines(int type, const char* exec, const char* wdir, int count);
+
+	// Processors all engines of the pool are restricted to, to be set
+	// before they are started
+	void SetAffinity(const int* cores, int n);
+
+	bool SetOption(const char* id, const char* value);
+	bool Synchronize(void);
+	bool SetSearchTime(int seconds);
+	bool SetSearchTimeMs(int milliseconds);
+	bool SetSearchNodes(long long nodes);
+	bool SetSearchDepth(int depth);
+	bool SetMultiPV(int k);
+	bool SetThreads(int n);
+	bool SetIsolation(int level);
+
+	// Deadline for searches without a time limit, after which a hanging
+	// engine is stopped and killed. An engine that crashed or was killed is
+	// restarted with the settings above and its positions are searched
+	// again, up to MAXRETRIES times per position before it is reported
+	// without a move.
+	enum { MAXRETRIES=2 };
+	bool SetWatchdog(int milliseconds);
+
+	// Results are reported via the handler in the order the positions were
+	// handed to Analyse, always from the thread calling Analyse/WaitForAll.
+	void SetResultHandler(resultFunction rf, void* param=0);
+
+	// In pipelined mode every engine that supports it gets the next position
+	// queued while it is still searching, so it can start the moment its
+	// bestmove arrives.
+	void SetPipelined(bool pipelined);
+
+	// Hand the position to an idle engine, waiting for one if all are busy.
+	bool Analyse(const char* epd);
+	bool Analyse(const char* epd, int length);
+	bool WaitForAll(void);
+
+	bool Stop(void);
+
+	int GetCount(void);
+	Engine* GetEngine(int i);
+
+	// Best moves that were not legal in their position, reported without
+	// a move
+	int GetIllegalMoves(void);
+
+	// Positions given up after MAXRETRIES, reported as failed without a move
+	int GetFailedPositions(void);
+
+	// SHA-256 of what decides the result of a search besides the position:
+	// the engine executable and its arguments, the protocol, the options
+	// sorted by name, the search limit, multipv and isolation. Returns true
+	// when the executable could not be read.
+	bool GetSettingsDigest(unsigned char digest[Sha256::DIGESTSIZE]);
+
+	int GetError(void);
+	const char* GetErrorStr();
+
+private:
+
+	typedef struct {
+		char* epd;
+		int bestMove;
+		int ponderMove;
+		Engine::searchStats_t stats;
+		int topCount;
+		int topMoves[Engine::MAXMULTIPV];
+		int retries;
+		bool failed;
+		bool done;
+	} job_t;
+
+	typedef enum {
+		limitNone=0,
+		limitSeconds,
+		limitMs,
+		limitNodes,
+		limitDepth
+	} limit_t;
+
+	typedef struct {
+		EnginePool* pool;
+		Engine* engine;
+		bool failed;
+	} init_t;
+
+	enum { MAXDEPTH=2 };
+
+	Engine** engines;
+	int engineType;
+	int affinity[Engine::MAXCORES];
+	int affinityCount;
+	int* engineJob;		// MAXDEPTH job ids per engine, running one first
+	int* engineLoad;
+	int* engineDepth;	// 0 for an engine that could not be restarted
+	bool* engineFailed;
+	int failures;
+	int initRunning;
+	int illegalMoves;
+	int failedPositions;
+	int count;
+	int freeSlots;
+	int slots;
+	bool pipelined;
+
+	job_t* jobs;
+	int jobSize;
+	int inputId;
+	int outputId;
+
+	// jobs waiting for an engine, in front of the position being analysed
+	int* pending;
+	int pendingCount;
+
+	// settings, to be replayed on a restarted engine
+	char** optionIds;
+	char** optionValues;
+	int optionCount;
+	int limitType;
+	long long limitValue;
+	int multiPV;
+	int threads;		// 0 when left to the engine
+	int isolation;
+	int watchdog;
+
+	resultFunction resultHandler;
+	void* resultParam;
+	Engine* errorEngine;
+
+	Mutex lock;
+	Condition idle;
+
+	job_t* Job(int id);
+	bool GrowJobs(void);
+	bool DeliverResults(void);
+	void EngineDone(Engine* engine);
+	void ValidateMoves(job_t* job, const char* text);
+	bool Submit(void);
+	void FailJob(int id);
+	bool RecoverEngines(void);
+	bool ConfigureEngine(Engine* engine);
+
+	friend void poolDoneHandler(Engine* engine, void* param);
+	friend int poolInitThread(void* param);
+};
+
+#endif // __ENGINEPOOL_H
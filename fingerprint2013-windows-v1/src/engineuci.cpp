@@ -1,383 +1,504 @@
-// Engineuci.cpp
-//
-// Copyright (C) 2008-2013, ir. R.L. Pijl
-
-#include <stdio.h>
-
-#include "engineuci.h"
-#include "util.h"
-
-UCIEngine::UCIEngine()
-{
-	searchDepth=-1;
-	searchTime=-1;
-	levelMoves=40;
-	levelSeconds=300;
-	levelInc=0;
-
-	timeOwnRemaining=300000;
-	timeOppRemaining=300000;
-
-	strcpy(fenPosition,"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w kqKQ -");
-}
-
-UCIEngine::~UCIEngine()
-{
-}
-
-bool
-UCIEngine::InitEngine(void)
-{
-	char buf[2048];
-
-	if (!started) {
-		errorNumber=ENGINENOTSTARTED;
-		return true;
-	}
-
-	fprintf(toengine,"uci\n");
-	do {
-		fgets(buf,2047,fromengine);
-		if (strncmp(buf,"copyprotection error",20)==0) {
-			errorNumber=ENGINECOPYPROT;
-			return true;
-		}
-		if (strncmp(buf,"id",2)==0) {
-			char *s;
-			s=strtok(buf," \t\n\r");
-			s=strtok(0," \t\n\r");
-			if (strncmp(s,"name",4)==0) {
-				s=strtok(0," \t\n\r");
-				// engine name is now in s
-				// TODO: do something with it
-				continue;
-			}
-			if (strncmp(s,"author",6)==0) {
-				s=strtok(0," \t\n\r");
-				// author name is now in s
-				// TODO: do something with it
-				continue;
-			}
-			// protocol error, ignore
-			continue;
-		}
-		if (strncmp(buf,"option", 6)==0) {
-			// Option sent.
-			char *s;
-			//printf(buf);
-			s=strtok(buf," \t\n\r");
-			s=strtok(0," \t\n\r");
-
-			// ponder, check
-			if (strncmp(s,"ponder",6)==0) {
-				// engine is obvious able to ponder.
-				optionPonder=true;
-				s=strtok(0," \t\n\r"); // type
-				s=strtok(0," \t\n\r"); // check
-				s=strtok(0," \t\n\r"); // default
-				s=strtok(0," \t\n\r");
-				if (strncmp(s,"true",4)==0)
-					ponderMode=true;
-				else
-					ponderMode=false;
-				continue;
-			}
-
-			// multipv, spin
-			if (strncmp(s,"multipv",7)==0) {
-				// engine is capable of multipv.
-				optionMultiPV=true;
-				s=strtok(0," \t\n\r"); // type
-				s=strtok(0," \t\n\r"); // spin
-				while(s=strtok(0," \t\n\r")) {
-					if (strncmp(s,"min",3)) {
-						multiPVmin=atoi(strtok(0,"\t\n\r"));
-						continue;
-					}
-					if (strncmp(s,"max",3)) {
-						multiPVmax=atoi(strtok(0,"\t\n\r"));
-						continue;
-					}
-					if (strncmp(s,"default",7)) {
-						multiPV=atoi(strtok(0,"\t\n\r"));
-						continue;
-					}
-				}
-				continue;
-			}
-
-			// UCI_ShowCurrLine, check
-			if (strncmp(s,"UCI_ShowCurrLine",16)==0) {
-				// engine is able to show the current line.
-				optionShowCurrline=true;
-				continue;
-			}
-
-			// UCI_ShowRefutations, check
-			if (strncmp(s,"UCI_ShowRefutations",19)==0) {
-				// engine is able to show refutations.
-				optionShowRefute=true;
-				continue;
-			}
-
-			// UCI_AnalyseMode, check
-			if (strncmp(s,"UCI_AnalyseMode",15)==0) {
-				// engine wants to be told about analysis mode.
-				optionAnalyzeMode=true;
-				continue;
-			}
-
-			continue;
-		}
-	} while (strncmp(buf,"uciok", 5)!=0);
-
-	errorNumber=ENGINEOK;
-	return false;
-}
-
-bool
-UCIEngine::SetOption(const char* id, const char* value)
-{
-	fprintf(toengine,"setoption name %s", id);
-	if (value) fprintf(toengine," value %s",value);
-	fprintf(toengine,"\n");
-	errorNumber=ENGINEOK;
-	return false;
-}
-
-bool
-UCIEngine::SetPosition(const char * fen)
-{
-	if (!fen) {
-		errorNumber=ENGINENOPOS;
-		return true;
-	}
-	strcpy(fenPosition,fen);
-
-	errorNumber=ENGINEOK;
-	return false;
-}
-
-bool
-UCIEngine::SetSearchDepth(int depth)
-{
-	levelMoves=-1;
-	searchDepth=depth;
-
-	errorNumber=ENGINEOK;
-	return false;
-}
-
-bool
-UCIEngine::SetSearchTime(int seconds)
-{
-	levelMoves=-1;
-	searchTime=seconds;
-
-	errorNumber=ENGINEOK;
-	return false;
-}
-
-bool
-UCIEngine::SetSearchLevel(int moves, int seconds, int inc)
-{
-	searchDepth=-1;
-	searchTime=-1;
-	levelMoves=moves;
-	levelSeconds=seconds;
-	levelInc=inc;
-
-	errorNumber=ENGINEOK;
-	return false;
-}
-
-bool
-UCIEngine::SetTimeRemaining(int milliseconds)
-{
-	timeOwnRemaining=milliseconds;
-
-	errorNumber=ENGINEOK;
-	return false;
-}
-
-bool
-UCIEngine::SetOppTimeRemaining (int milliseconds)
-{
-	timeOppRemaining=milliseconds;
-
-	errorNumber=ENGINEOK;
-	return false;
-}
-
-bool
-UCIEngine::Search(int mode, searchPVFunction pvf, searchFRFunction frf, searchCMFunction cmf, searchRefFunction rf, searchStrFunction sf, int move)
-{
-    DWORD dwThreadId;
-    HANDLE hThread; 
-
-	if (!started) {
-		errorNumber=ENGINENOTSTARTED;
-		return true;
-	}
-
-	if (searching) {
-		errorNumber=ENGINEALREADYSEARCH;
-		return true;
-	}
-
-	// register handler functions.
-	if (frf==0) {
-		errorNumber=ENGINENOFRF;
-		return true;
-	}
-	finHandler=frf;
-	// rest is optional
-	pvHandler=pvf;
-	cmHandler=cmf;
-	refHandler=rf;
-	strHandler=sf;
-
-	// create thread with result reading loop
-	hThread=CreateThread(NULL, 0, startResponseThread, this, 0, &dwThreadId);
-	if (hThread==0) {
-		errorNumber=ENGINENORESPTHREAD;
-		return true;
-	}
-	// start search
-	searching=true;
-	fprintf(toengine,"position fen %s\n",fenPosition);
-	if (searchTime>0)
-		fprintf(toengine,"go movetime %d000\n",searchTime);
-	else
-		return true;
-
-	errorNumber=ENGINEOK;
-	return false;
-}
-
-bool
-UCIEngine::ResponseThread(void)
-{
-	char buf[2048];
-	char *s;
-	// analyze the engine responses
-	do {
-		fgets(buf,2047,fromengine);
-		//cout << buf << endl;
-		s=strtok(buf," \t\n\r");
-		if (!s) continue;
-		if (strncmp(s,"bestmove",8)==0) {
-			int move, pmove=0;
-			// send final report and exit
-			s=strtok(0," \n\r\t");
-			move=ParseMove(s);
-			s=strtok(0," \n\r\t");
-			if (s) {
-				s=strtok(0," \n\r\t");
-				pmove=ParseMove(s);
-			}
-			if (finHandler(move,pmove)) {
-				searching=false;
-				return true;
-			}
-			searching=false;
-			return false;
-		}
-		if (strncmp(s, "info", 4)==0) {
-			int depth=-1, seldepth=-1, multi=0, score=0, time=-1, nodes=-1, tbhits=-1, hashfull=0;
-			while (s=strtok(0," \n\r\t")) {
-				if (strncmp(s,"multi",5)==0) {
-					s=strtok(0," \n\r\t");
-					multi=atoi(s);
-					continue;
-				}
-				if (strncmp(s,"depth",5)==0) {
-					s=strtok(0," \n\r\t");
-					depth=atoi(s);
-					continue;
-				}
-				if (strncmp(s,"seldepth",8)==0) {
-					s=strtok(0," \n\r\t");
-					seldepth=atoi(s);
-					continue;
-				}
-				if (strncmp(s,"score",5)==0) {
-					s=strtok(0," \n\r\t"); // type of score
-					if (strncmp(s,"cp",2)==0) {
-						s=strtok(0," \n\r\t"); // type of score
-						score=atoi(s);
-						continue;
-					}
-					if (strncmp(s,"mate",4)==0) {
-						s=strtok(0," \n\r\t"); // type of score
-						score=atoi(s);
-						if (score>0)
-							score=100000-score;
-						if (score<0)
-							score=-100000-score;
-						continue;
-					}
-					continue;
-				}
-				if (strncmp(s,"time",4)==0) {
-					s=strtok(0," \n\r\t");
-					time=atoi(s);
-					continue;
-				}
-				if (strncmp(s,"nodes",5)==0) {
-					s=strtok(0," \n\r\t");
-					nodes=atoi(s);
-					continue;
-				}
-				if (strncmp(s,"tbhits",6)==0) {
-					s=strtok(0," \n\r\t");
-					tbhits=atoi(s);
-					continue;
-				}
-				if (strncmp(s,"hashfull",8)==0) {
-					s=strtok(0," \n\r\t");
-					hashfull=atoi(s);
-					continue;
-				}
-				if (strncmp(s,"pv",2)==0) {
-					s=strtok(0,"\n\r");
-					if (pvHandler) pvHandler(multi, depth,seldepth,score,time,nodes,tbhits,hashfull,s);
-					break;
-				}
-				// unknown, just continue;
-			}
-		}
-		
-	} while (1);
-	return false;
-}
-
-bool
-UCIEngine::SearchStop(void)
-{
-	if (!started) {
-		errorNumber=ENGINENOTSTARTED;
-		return true;
-	}
-
-	if (!searching) {
-		errorNumber=ENGINENOSEARCH;
-		return true;
-	}
-
-	fprintf(toengine,"stop\n");
-
-	// response will follow via the registered FRhandler
-
-	errorNumber=ENGINEOK;
-	return false;
-}
-
-bool
-UCIEngine::Stop(void)
-{
-	unsigned int i=0;
-	fprintf(toengine,"quit\n");
-
-	return WaitForStop();
-}
+// Engineuci.cpp
+//
+// Copyright (C) 2008-2013, ir. R.L. Pijl
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "engineuci.h"
+#include "uciinfo.h"
+#include "util.h"
+
+UCIEngine::UCIEngine()
+{
+	searchDepth=-1;
+	searchTime=-1;
+	searchNodes=-1;
+	levelMoves=40;
+	levelSeconds=300;
+	levelInc=0;
+
+	timeOwnRemaining=300000;
+	timeOppRemaining=300000;
+
+	strcpy(fenPosition,"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w kqKQ -");
+
+	isolation=isolateNone;
+	*clearHashName='\0';
+	*threadsName='\0';
+}
+
+UCIEngine::~UCIEngine()
+{
+}
+
+typedef struct {
+	char name[128];
+	char type[16];
+	char def[128];
+	bool hasMin;
+	bool hasMax;
+	int min;
+	int max;
+} uciOption_t;
+
+// Option names are case insensitive
+static bool sameName(const char* a, const char* b)
+{
+	while (*a && tolower((unsigned char)*a)==tolower((unsigned char)*b)) {
+		a++;
+		b++;
+	}
+	return *a==*b;
+}
+
+static void appendWord(char* field, int size, const char* word)
+{
+	int n=(int)strlen(field);
+
+	// names and defaults may consist of several words
+	if (n>0 && n<size-1)
+		field[n++]=' ';
+	strncpy(field+n,word,size-n-1);
+	field[size-1]='\0';
+}
+
+static void parseOption(char* buf, uciOption_t* option)
+{
+	// option name <id> type <t> [default <x>] [min <x>] [max <x>] [var <x>]*
+	char *s, *next=buf, *field=0;
+	int size=0;
+
+	memset(option,0,sizeof(uciOption_t));
+	NextToken(&next," \t\n\r");
+	while ((s=NextToken(&next," \t\n\r"))) {
+		if (strcmp(s,"name")==0 && !*option->name) {
+			field=option->name;
+			size=sizeof(option->name);
+		} else if (strcmp(s,"type")==0) {
+			field=option->type;
+			size=sizeof(option->type);
+		} else if (strcmp(s,"default")==0) {
+			field=option->def;
+			size=sizeof(option->def);
+		} else if (strcmp(s,"min")==0 && (s=NextToken(&next," \t\n\r"))) {
+			option->hasMin=true;
+			option->min=atoi(s);
+			field=0;
+		} else if (strcmp(s,"max")==0 && (s=NextToken(&next," \t\n\r"))) {
+			option->hasMax=true;
+			option->max=atoi(s);
+			field=0;
+		} else if (strcmp(s,"var")==0) {
+			field=0;
+		} else if (field)
+			appendWord(field,size,s);
+	}
+}
+
+bool
+UCIEngine::InitEngine(void)
+{
+	char buf[2048];
+
+	if (!started) {
+		errorNumber=ENGINENOTSTARTED;
+		return true;
+	}
+
+	fprintf(toengine,"uci\n");
+	do {
+		if (ReadLine(buf,sizeof(buf)))
+			return true;
+		if (strncmp(buf,"copyprotection error",20)==0) {
+			errorNumber=ENGINECOPYPROT;
+			return true;
+		}
+		if (strncmp(buf,"id",2)==0) {
+			char *s, *next;
+			next=buf;
+			s=NextToken(&next," \t\n\r");
+			s=NextToken(&next," \t\n\r");
+			if (strncmp(s,"name",4)==0) {
+				s=NextToken(&next," \t\n\r");
+				// engine name is now in s
+				// TODO: do something with it
+				continue;
+			}
+			if (strncmp(s,"author",6)==0) {
+				s=NextToken(&next," \t\n\r");
+				// author name is now in s
+				// TODO: do something with it
+				continue;
+			}
+			// protocol error, ignore
+			continue;
+		}
+		if (strncmp(buf,"option", 6)==0) {
+			uciOption_t option;
+
+			parseOption(buf,&option);
+
+			// Ponder, check
+			if (sameName(option.name,"Ponder")) {
+				// engine is obvious able to ponder.
+				optionPonder=true;
+				ponderMode=strcmp(option.def,"true")==0;
+				continue;
+			}
+
+			// MultiPV, spin
+			if (sameName(option.name,"MultiPV")) {
+				// engine is capable of multipv.
+				optionMultiPV=true;
+				if (*option.def) multiPV=atoi(option.def);
+				if (option.hasMin) multiPVmin=option.min;
+				if (option.hasMax) multiPVmax=option.max;
+				continue;
+			}
+
+			// Threads or Cores, spin
+			if (sameName(option.name,"Threads") || sameName(option.name,"Cores")) {
+				strcpy(threadsName,option.name);
+				continue;
+			}
+
+			// Clear Hash, button
+			if (sameName(option.name,"Clear Hash") || sameName(option.name,"Clear_Hash")) {
+				strcpy(clearHashName,option.name);
+				continue;
+			}
+
+			// UCI_ShowCurrLine, check
+			if (sameName(option.name,"UCI_ShowCurrLine")) {
+				// engine is able to show the current line.
+				optionShowCurrline=true;
+				continue;
+			}
+
+			// UCI_ShowRefutations, check
+			if (sameName(option.name,"UCI_ShowRefutations")) {
+				// engine is able to show refutations.
+				optionShowRefute=true;
+				continue;
+			}
+
+			// UCI_AnalyseMode, check
+			if (sameName(option.name,"UCI_AnalyseMode")) {
+				// engine wants to be told about analysis mode.
+				optionAnalyzeMode=true;
+				continue;
+			}
+
+			continue;
+		}
+	} while (strncmp(buf,"uciok", 5)!=0);
+
+	errorNumber=ENGINEOK;
+	return false;
+}
+
+bool
+UCIEngine::SetOption(const char* id, const char* value)
+{
+	fprintf(toengine,"setoption name %s", id);
+	if (value) fprintf(toengine," value %s",value);
+	fprintf(toengine,"\n");
+	errorNumber=ENGINEOK;
+	return false;
+}
+
+bool
+UCIEngine::SetMultiPV(int k)
+{
+	char value[16];
+
+	if (k==multiPV) {
+		errorNumber=ENGINEOK;
+		return false;
+	}
+	if (!optionMultiPV || k<multiPVmin || k>multiPVmax || k<1 || k>MAXMULTIPV) {
+		errorNumber=ENGINENOTSUPP;
+		return true;
+	}
+	sprintf(value,"%d",k);
+	multiPV=k;
+	return SetOption("MultiPV",value);
+}
+
+bool
+UCIEngine::SetThreads(int n)
+{
+	char value[16];
+
+	if (!*threadsName) {
+		errorNumber=ENGINENOTSUPP;
+		return true;
+	}
+	sprintf(value,"%d",n);
+	return SetOption(threadsName,value);
+}
+
+bool
+UCIEngine::SetIsolation(int level)
+{
+	if (level<isolateNone || level>isolateClearHash) {
+		errorNumber=ENGINENOTSUPP;
+		return true;
+	}
+	// without a Clear Hash button ucinewgame is all the engine offers
+	isolation=level;
+	errorNumber=ENGINEOK;
+	return false;
+}
+
+bool
+UCIEngine::SetPosition(const char * fen)
+{
+	if (!fen) {
+		errorNumber=ENGINENOPOS;
+		return true;
+	}
+	strcpy(fenPosition,fen);
+
+	errorNumber=ENGINEOK;
+	return false;
+}
+
+bool
+UCIEngine::SetSearchDepth(int depth)
+{
+	levelMoves=-1;
+	searchTime=-1;
+	searchNodes=-1;
+	searchDepth=depth;
+	searchDeadline=0;
+
+	errorNumber=ENGINEOK;
+	return false;
+}
+
+bool
+UCIEngine::SetSearchTime(int seconds)
+{
+	return SetSearchTimeMs(seconds*1000);
+}
+
+bool
+UCIEngine::SetSearchTimeMs(int milliseconds)
+{
+	levelMoves=-1;
+	searchDepth=-1;
+	searchNodes=-1;
+	searchTime=milliseconds;
+	searchDeadline=milliseconds+GRACETIME;
+
+	errorNumber=ENGINEOK;
+	return false;
+}
+
+bool
+UCIEngine::SetSearchNodes(long long nodes)
+{
+	levelMoves=-1;
+	searchDepth=-1;
+	searchTime=-1;
+	searchNodes=nodes;
+	searchDeadline=0;
+
+	errorNumber=ENGINEOK;
+	return false;
+}
+
+bool
+UCIEngine::SetSearchLevel(int moves, int seconds, int inc)
+{
+	searchDepth=-1;
+	searchTime=-1;
+	searchNodes=-1;
+	searchDeadline=0;
+	levelMoves=moves;
+	levelSeconds=seconds;
+	levelInc=inc;
+
+	errorNumber=ENGINEOK;
+	return false;
+}
+
+bool
+UCIEngine::SetTimeRemaining(int milliseconds)
+{
+	timeOwnRemaining=milliseconds;
+
+	errorNumber=ENGINEOK;
+	return false;
+}
+
+bool
+UCIEngine::SetOppTimeRemaining (int milliseconds)
+{
+	timeOppRemaining=milliseconds;
+
+	errorNumber=ENGINEOK;
+	return false;
+}
+
+bool
+UCIEngine::Search(int mode, searchPVFunction pvf, searchFRFunction frf, searchCMFunction cmf, searchRefFunction rf, searchStrFunction sf, int move)
+{
+	char cmd[1024];
+
+	if (!started) {
+		errorNumber=ENGINENOTSTARTED;
+		return true;
+	}
+
+	if (searching) {
+		errorNumber=ENGINEALREADYSEARCH;
+		return true;
+	}
+
+	// register handler functions.
+	if (frf==0) {
+		errorNumber=ENGINENOFRF;
+		return true;
+	}
+	finHandler=frf;
+	// rest is optional
+	pvHandler=pvf;
+	cmHandler=cmf;
+	refHandler=rf;
+	strHandler=sf;
+
+	// start search, the responses are handled by the reactor
+	if (PrepareSearch(cmd,sizeof(cmd)) || StartSearch())
+		return true;
+	if (Send(cmd))
+		return true;
+
+	errorNumber=ENGINEOK;
+	return false;
+}
+
+bool
+UCIEngine::PrepareSearch(char* cmd, int size)
+{
+	int n=0;
+
+	if (isolation>=isolateNewGame) {
+		n+=snprintf(cmd+n,size-n,"ucinewgame\n");
+		if (isolation==isolateClearHash && *clearHashName)
+			n+=snprintf(cmd+n,size-n,"setoption name %s\n",clearHashName);
+		// the engine handles the commands in order, so nobody needs to wait
+		// for the readyok
+		n+=snprintf(cmd+n,size-n,"isready\n");
+	}
+	n+=snprintf(cmd+n,size-n,"position fen %s\n",fenPosition);
+
+	if (searchNodes>0)
+		snprintf(cmd+n,size-n,"go nodes %lld\n",searchNodes);
+	else if (searchDepth>0)
+		snprintf(cmd+n,size-n,"go depth %d\n",searchDepth);
+	else if (searchTime>0)
+		snprintf(cmd+n,size-n,"go movetime %d\n",searchTime);
+	else if (levelMoves>=0) {
+		// clock times are given from the side to move's point of view
+		const char* stm=strchr(fenPosition,' ');
+		bool white=!(stm && stm[1]=='b');
+		int inc=levelInc*1000;
+
+		n+=snprintf(cmd+n,size-n,"go wtime %d btime %d winc %d binc %d",
+			white ? timeOwnRemaining : timeOppRemaining,
+			white ? timeOppRemaining : timeOwnRemaining, inc, inc);
+		if (levelMoves>0)
+			n+=snprintf(cmd+n,size-n," movestogo %d",levelMoves);
+		snprintf(cmd+n,size-n,"\n");
+	} else {
+		errorNumber=ENGINENOTSUPP;
+		return true;
+	}
+
+	errorNumber=ENGINEOK;
+	return false;
+}
+
+int
+UCIEngine::ResponseLine(char* buf)
+{
+	char *s, *next;
+	// analyze the engine response
+	//cout << buf << endl;
+	next=buf;
+	s=NextToken(&next," \t\n\r");
+	if (!s) return searchInfoNone;
+	if (strncmp(s,"bestmove",8)==0) {
+		int move, pmove=0;
+		char* text;
+		// send final report and exit
+		text=s=NextToken(&next," \n\r\t");
+		move=ParseMove(s);
+		s=NextToken(&next," \n\r\t");
+		if (s) {
+			s=NextToken(&next," \n\r\t");
+			pmove=ParseMove(s);
+		}
+		FinishSearch(move,pmove,text);
+		return searchInfoFinal;
+	}
+	if (strcmp(s,"readyok")==0) {
+		// answer to the isready sent in front of the search
+		return searchInfoNone;
+	}
+	if (strcmp(s,"info")==0) {
+		uciInfo_t info;
+
+		if (next)
+			next[strcspn(next,"\n\r")]='\0';
+		ParseUCIInfo(next ? next : "",&info);
+		if (info.pv)
+			ReportPV(info.multi,info.depth,info.seldepth,info.score,info.time,info.nodes,
+				info.tbhits,info.hashfull,info.pv);
+		else {
+			// the last nodes and time often come without a pv
+			ReportStats(info.multi,info.depth,info.seldepth,info.time,info.nodes);
+			if (info.currmove && cmHandler)
+				cmHandler(info.currmovenr,info.currmove,"");
+			else if (info.string && strHandler)
+				strHandler(info.string);
+		}
+		return searchInfoInformative;
+	}
+	return searchInfoNone;
+}
+
+bool
+UCIEngine::SearchStop(void)
+{
+	if (!started) {
+		errorNumber=ENGINENOTSTARTED;
+		return true;
+	}
+
+	if (!searching) {
+		errorNumber=ENGINENOSEARCH;
+		return true;
+	}
+
+	fprintf(toengine,"stop\n");
+
+	// response will follow via the registered FRhandler
+
+	errorNumber=ENGINEOK;
+	return false;
+}
+
+bool
+UCIEngine::Stop(void)
+{
+	unsigned int i=0;
+	fprintf(toengine,"quit\n");
+
+	return WaitForStop();
+}
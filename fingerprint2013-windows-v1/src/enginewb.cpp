@@ -1,333 +1,579 @@
-// Enginewb.cpp
-//
-// Copyright (C) 2008-2013, ir. R.L. Pijl
-
-#include <stdio.h>
-#include "enginewb.h"
-#include "util.h"
-
-static int pingseq=1;
-
-WBEngine::WBEngine()
-{
-	myname[0]='\0';
-	fping=false;
-	fsetboard=false;
-	fplayother=false;
-	fsan=false;
-	fusermove=false;
-	ftime=true;
-	fdraw=true;
-	fsigint=true;
-	fsigterm=true;
-	freuse=true;
-	fanalyze=true;
-	for (int i=0; i<16; i++) fvariants[i]=true;
-	fcolors=true;
-	fics=false;
-	fname=true;
-	fpause=false;
-}
-
-WBEngine::~WBEngine()
-{
-}
-
-bool
-WBEngine::InitEngine(void)
-{
-	char buf[2048];
-	char *s;
-	int timeout=2;
-
-	if (!started) {
-		errorNumber=ENGINENOTSTARTED;
-		return true;
-	}
-
-	fprintf(toengine,"xboard\n");
-	fgets(buf,2047,fromengine); 
-	if (strncmp(buf,"feature done=0", 14)==0) timeout=3600;
-	fprintf(toengine,"protover 2\n");
-
-	// TODO: start 2 seconds timer
-	do {
-		fgets(buf,2047,fromengine); // TODO: make interuptable by timer
-		s=strtok(buf," \n\r\t");
-		if (!s) continue;
-		if (strncmp(s,"feature",7) != 0)
-			continue;
-		s=strtok(0,"= \n\r\t");
-		if (!s) continue;
-
-		if (strncmp(s,"done",4)==0) {
-			fprintf(toengine,"accepted done\n");
-			s=strtok(0," \n\r\t");
-			if (!s) continue;
-			if (*s=='0') {
-				timeout=3600;
-				continue;
-			}
-			if (*s=='1') break;
-			continue;
-		}
-
-		if (strncmp(s,"ping",4)==0) {
-			fprintf(toengine,"accepted ping\n");
-			s=strtok(0," \n\t\r");
-			if (!s) continue;
-			fping=(*s=='1');
-			continue;
-		}
-
-		if (strncmp(s,"setboard",8)==0) {
-			fprintf(toengine,"accepted setboard\n");
-			s=strtok(0," \n\t\r");
-			if (!s) continue;
-			fsetboard=(*s=='1');
-			continue;
-		}
-
-		if (strncmp(s,"usermove",8)==0) {
-			fprintf(toengine,"accepted usermove\n");
-			s=strtok(0," \n\t\r");
-			if (!s) continue;
-			fusermove=(*s=='1');
-			continue;
-		}
-
-		if (strncmp(s,"san",3)==0) {
-			fprintf(toengine,"accepted san\n");
-			s=strtok(0," \n\t\r");
-			if (!s) continue;
-			fsan=(*s=='1');
-			continue;
-		}
-
-		// TODO: set remaining features
-		fprintf(toengine,"accepted %s\n",s);
-
-	} while (1);
-
-	// Finalize initialization by sending initial commands to setup the engine
-	fprintf(toengine,"new\n");
-	fprintf(toengine,"post\n");
-	fprintf(toengine,"easy\n");
-	Synchronize();
-
-	errorNumber=ENGINEOK;
-	return false;
-}
-
-bool
-WBEngine::Synchronize(void)
-{
-	char buf[2048];
-
-	if (fping) {
-		fprintf(toengine,"ping %d\n",pingseq++);
-		do {
-			fgets(buf,2047,fromengine);
-		} while (strncmp(buf,"pong",4));
-	}
-
-	errorNumber=ENGINEOK;
-	return false;
-}
-
-bool
-WBEngine::SetPosition(const char * fen)
-{
-	char buf[2048];
-
-	if (!fen) {
-		errorNumber=ENGINENOPOS;
-		return true;
-	}
-
-	if (fsetboard&&fping) {
-		fprintf(toengine,"setboard %s\n", fen);
-		fprintf(toengine,"ping %d\n",pingseq++);
-		do {
-			fgets(buf,2047,fromengine);
-			if (strncmp(buf,"Error",5)==0) {
-				if (strstr(buf,"setboard")) {
-					errorNumber=ENGINEILLPOS;
-					return true;
-				}
-				continue;
-			}
-		} while (strncmp(buf,"pong",4));
-
-		errorNumber=ENGINEOK;
-		return false;
-	}
-
-	// TODO: Implementation of 'edit'
-	errorNumber=ENGINENOTSUPP;
-	return true;
-}
-
-bool
-WBEngine::SetSearchDepth(int depth)
-{
-	fprintf(toengine,"sd %d\n",depth);
-	errorNumber=ENGINEOK;
-	return false;
-}
-
-bool
-WBEngine::SetSearchTime(int seconds)
-{
-	fprintf(toengine,"st %d\n",seconds);
-	errorNumber=ENGINEOK;
-	return false;
-}
-
-bool
-WBEngine::SetSearchLevel(int moves, int seconds, int inc)
-{
-	if (seconds%60)
-		fprintf(toengine,"level %d %d:%d %d\n",moves,seconds/60,seconds%60,inc);
-	else
-		fprintf(toengine,"level %d %d %d\n",moves,seconds/60,inc);
-
-	errorNumber=ENGINEOK;
-	return false;
-}
-
-bool
-WBEngine::SetTimeRemaining(int milliseconds)
-{
-	if (ftime) {
-		fprintf(toengine,"time %d\n",milliseconds/10);
-	}
-
-	errorNumber=ENGINEOK;
-	return false;
-}
-
-bool
-WBEngine::SetOppTimeRemaining (int milliseconds)
-{
-	if (ftime) {
-		fprintf(toengine,"otim %d\n",milliseconds/10);
-	}
-
-	errorNumber=ENGINEOK;
-	return false;
-}
-
-bool
-WBEngine::Search(int mode, searchPVFunction pvf, searchFRFunction frf, searchCMFunction cmf, searchRefFunction rf, searchStrFunction sf, int move)
-{
-    DWORD dwThreadId;
-    HANDLE hThread; 
-
-	if (!started) {
-		errorNumber=ENGINENOTSTARTED;
-		return true;
-	}
-
-	if (searching) {
-		errorNumber=ENGINEALREADYSEARCH;
-		return true;
-	}
-
-	// register handler functions.
-	if (frf==0) {
-		errorNumber=ENGINENOFRF;
-		return true;
-	}
-	finHandler=frf;
-	// rest is optional
-	pvHandler=pvf;
-	cmHandler=cmf;
-	refHandler=rf;
-	strHandler=sf;
-
-	// create thread with result reading loop
-	hThread=CreateThread(NULL, 0, startResponseThread, this, 0, &dwThreadId);
-	if (hThread==0) {
-		errorNumber=ENGINENORESPTHREAD;
-		return true;
-	}
-	// start search
-	searching=true;
-	fprintf(toengine,"go\n");
-
-	errorNumber=ENGINEOK;
-	return false;
-}
-
-bool
-WBEngine::ResponseThread(void)
-{
-	char buf[2048];
-	char *s;
-	// analyze the engine responses
-	do {
-		fgets(buf,2047,fromengine);
-		//cout << buf << endl;
-		s=strtok(buf," \t\n\r");
-
-		if (strncmp(s,"move",4)==0) {
-			// played a move, call finHandler
-			int move;
-			s=strtok(0," \t\n\r");
-			move=ParseMove(s);
-			if (finHandler) finHandler(move,0);
-			break;
-		}
-
-		// TODO: include other defined responses that could be sent here
-
-		if (isdigit(*s)) {
-			// TODO
-			// probably a PV, check if it is
-			int depth, score, time, nodes;
-			s=strtok(0," \t\n\r"); depth=atoi(s);
-			s=strtok(0," \t\n\r"); score=atoi(s);
-			s=strtok(0," \t\n\r"); time=atoi(s);
-			s=strtok(0," \t\n\r"); nodes=atoi(s);
-			s=strtok(0,"\n\r");
-
-			// call pvhandler
-			if (pvHandler) pvHandler(0,depth,-1,score,time,nodes,-1,0,s);
-			continue;
-		}
-
-	} while (1);
-	searching=false;
-	return false;
-}
-
-bool
-WBEngine::SearchStop(void)
-{
-	if (!started) {
-		errorNumber=ENGINENOTSTARTED;
-		return true;
-	}
-
-	if (!searching) {
-		errorNumber=ENGINENOSEARCH;
-		return true;
-	}
-
-	fprintf(toengine,"?\n");
-
-	// response will follow via the registered FRhandler
-
-	errorNumber=ENGINEOK;
-	return false;
-}
-
-bool
-WBEngine::Stop(void)
-{
-	unsigned int i=0;
-	fprintf(toengine,"quit\n");
-
-	return WaitForStop();
-}
+// Enginewb.cpp
+//
+// Copyright (C) 2008-2013, ir. R.L. Pijl
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "enginewb.h"
+#include "util.h"
+
+WBEngine::WBEngine()
+{
+	myname[0]='\0';
+	fping=false;
+	fsetboard=false;
+	fplayother=false;
+	fsan=false;
+	fusermove=false;
+	ftime=true;
+	fdraw=true;
+	fsigint=true;
+	fsigterm=true;
+	freuse=true;
+	fanalyze=true;
+	for (int i=0; i<16; i++) fvariants[i]=true;
+	fcolors=true;
+	fics=false;
+	fname=true;
+	fpause=false;
+	fnps=true;
+	fsmp=false;
+	npsMode=false;
+	fenPosition[0]='\0';
+	limitCmd[0]='\0';
+	pingSeq=0;
+	lastPong=0;
+	rejectedPing=-1;
+}
+
+WBEngine::~WBEngine()
+{
+}
+
+static bool nextFeature(char** s, char** name, const char** value)
+{
+	// name=value or name="value with spaces", terminated in place
+	char* p=*s;
+
+	p+=strspn(p," \t\r\n");
+	if (!*p)
+		return false;
+	*name=p;
+	p+=strcspn(p,"= \t\r\n");
+	if (*p=='=') {
+		*p++='\0';
+		if (*p=='"') {
+			*value=++p;
+			p+=strcspn(p,"\"");
+		} else {
+			*value=p;
+			p+=strcspn(p," \t\r\n");
+		}
+	} else
+		*value="";
+	if (*p) *p++='\0';
+	*s=p;
+	return true;
+}
+
+// Protocol version 1 engines only show themselves by staying silent for
+// FEATURETIME after protover. This is found out once for every executable,
+// other instances wait for the first one and skip the timeout.
+typedef enum {
+	probeRunning=0,
+	probeSilent,
+	probeFeatures
+} probeState_t;
+
+typedef struct probe_s {
+	char* exec;
+	int state;
+	struct probe_s* next;
+} probe_t;
+
+static probe_t* probes=0;
+static Mutex probeLock;
+static Condition probeDone;
+
+bool
+WBEngine::InitEngine(void)
+{
+	probe_t* probe;
+	bool owner=false, silent=false, rv;
+
+	if (!started) {
+		errorNumber=ENGINENOTSTARTED;
+		return true;
+	}
+
+	probeLock.Lock();
+	for (probe=probes; probe && strcmp(probe->exec,GetExecName()); probe=probe->next)
+		;
+	if (!probe) {
+		probe=new probe_t;
+		probe->exec=strdup(GetExecName());
+		probe->state=probeRunning;
+		probe->next=probes;
+		probes=probe;
+		owner=true;
+	}
+	while (probe->state==probeRunning && !owner)
+		probeDone.Wait(probeLock);
+	probeLock.Unlock();
+
+	if (!owner && probe->state==probeSilent) {
+		// the protover is sent anyway, like a GUI would
+		fprintf(toengine,"xboard\nprotover 2\n");
+		silent=true;
+		rv=false;
+	} else
+		rv=NegotiateFeatures(&silent);
+
+	if (owner) {
+		probeLock.Lock();
+		probe->state=(!rv && silent) ? probeSilent : probeFeatures;
+		probeDone.Broadcast();
+		probeLock.Unlock();
+	}
+	if (rv)
+		return true;
+
+	// Finalize initialization by sending initial commands to setup the engine
+	fprintf(toengine,"new\n");
+	fprintf(toengine,"post\n");
+	fprintf(toengine,"easy\n");
+	Synchronize();
+
+	errorNumber=ENGINEOK;
+	return false;
+}
+
+bool
+WBEngine::NegotiateFeatures(bool* silent)
+{
+	char buf[2048];
+	char *s, *next, *name;
+	const char* value;
+	unsigned long long deadline, now;
+	bool done=false;
+
+	// Version 2 engines announce their features, several per line, and end
+	// with done=1. An engine silent for FEATURETIME is taken to be version
+	// 1, done=0 asks for DONETIME to finish.
+	*silent=true;
+	fprintf(toengine,"xboard\nprotover 2\n");
+	deadline=TimeMs()+FEATURETIME;
+	while (!done) {
+		now=TimeMs();
+		if (now>=deadline)
+			break;
+		if (ReadLine(buf,sizeof(buf),(int)(deadline-now))) {
+			if (errorNumber==ENGINETIMEOUT)
+				break;
+			return true;
+		}
+		next=buf;
+		s=NextToken(&next," \n\r\t");
+		if (!s || strcmp(s,"feature")!=0)
+			continue;
+
+		*silent=false;
+		while (nextFeature(&next,&name,&value)) {
+			fprintf(toengine,"accepted %s\n",name);
+			if (strcmp(name,"done")==0) {
+				if (*value=='0')
+					deadline=TimeMs()+DONETIME;
+				else if (*value=='1')
+					done=true;
+				continue;
+			}
+			SetFeature(name,value);
+		}
+	}
+
+	errorNumber=ENGINEOK;
+	return false;
+}
+void
+WBEngine::SetFeature(const char* feature, const char* value)
+{
+	// features not listed are accepted and left unused
+	bool on=(*value=='1');
+
+	if (strcmp(feature,"ping")==0)
+		fping=on;
+	else if (strcmp(feature,"setboard")==0)
+		fsetboard=on;
+	else if (strcmp(feature,"playother")==0)
+		fplayother=on;
+	else if (strcmp(feature,"san")==0)
+		fsan=on;
+	else if (strcmp(feature,"usermove")==0)
+		fusermove=on;
+	else if (strcmp(feature,"time")==0)
+		ftime=on;
+	else if (strcmp(feature,"draw")==0)
+		fdraw=on;
+	else if (strcmp(feature,"sigint")==0)
+		fsigint=on;
+	else if (strcmp(feature,"sigterm")==0)
+		fsigterm=on;
+	else if (strcmp(feature,"reuse")==0)
+		freuse=on;
+	else if (strcmp(feature,"analyze")==0)
+		fanalyze=on;
+	else if (strcmp(feature,"colors")==0)
+		fcolors=on;
+	else if (strcmp(feature,"ics")==0)
+		fics=on;
+	else if (strcmp(feature,"name")==0)
+		fname=on;
+	else if (strcmp(feature,"pause")==0)
+		fpause=on;
+	else if (strcmp(feature,"nps")==0)
+		fnps=on;
+	else if (strcmp(feature,"smp")==0)
+		fsmp=on;
+	else if (strcmp(feature,"myname")==0)
+		snprintf(myname,sizeof(myname),"%s",value);
+}
+
+bool
+WBEngine::Synchronize(void)
+{
+	char buf[2048];
+	int seq;
+
+	if (fping) {
+		seq=++pingSeq;
+		fprintf(toengine,"ping %d\n",seq);
+		do {
+			if (ReadLine(buf,sizeof(buf)))
+				return true;
+		} while (strncmp(buf,"pong",4) || atoi(buf+4)!=seq);
+		lastPong=seq;
+	}
+
+	errorNumber=ENGINEOK;
+	return false;
+}
+
+bool
+WBEngine::SetPosition(const char * fen)
+{
+	if (!fen) {
+		errorNumber=ENGINENOPOS;
+		return true;
+	}
+
+	// sent together with the search, with setboard or else in edit mode
+	if (!fsetboard && EditCommands(fen,0,0)<0) {
+		errorNumber=ENGINEILLPOS;
+		return true;
+	}
+	snprintf(fenPosition,sizeof(fenPosition),"%s",fen);
+
+	errorNumber=ENGINEOK;
+	return false;
+}
+
+int
+WBEngine::EditCommands(const char* fen, char* cmd, int size)
+{
+	// The piece placement of the FEN in edit mode: # clears the board, c
+	// switches to black and . leaves edit mode. The engine works out the
+	// castling rights from the king and rook squares, en passant is lost.
+	// Returns the length, -1 for a FEN that cannot be decoded.
+	int n=0;
+
+	n+=snprintf(cmd,size,"edit\n#\n");
+	for (int black=0; black<2; black++) {
+		int rank=7, file=0;
+
+		if (black)
+			n+=snprintf(cmd ? cmd+n : 0,cmd ? size-n : 0,"c\n");
+		for (const char* p=fen; *p && *p!=' '; p++) {
+			if (*p=='/') {
+				if (file!=8 || --rank<0)
+					return -1;
+				file=0;
+				continue;
+			}
+			if (*p>='1' && *p<='8') {
+				file+=*p-'0';
+				if (file>8)
+					return -1;
+				continue;
+			}
+			if (!strchr("PNBRQKpnbrqk",*p) || file>7)
+				return -1;
+			if ((islower(*p)!=0)==(black!=0))
+				n+=snprintf(cmd ? cmd+n : 0,cmd ? size-n : 0,"%c%c%d\n",toupper(*p),'a'+file,rank+1);
+			file++;
+		}
+		if (rank!=0 || file!=8)
+			return -1;
+	}
+	n+=snprintf(cmd ? cmd+n : 0,cmd ? size-n : 0,".\n");
+	return n;
+}
+
+void
+WBEngine::ClearNps(void)
+{
+	// a node limit is a node rate, it stays in force until reset
+	if (npsMode) {
+		fprintf(toengine,"nps 0\n");
+		npsMode=false;
+	}
+}
+
+bool
+WBEngine::SetSearchDepth(int depth)
+{
+	ClearNps();
+	searchDeadline=0;
+	snprintf(limitCmd,sizeof(limitCmd),"sd %d\n",depth);
+	fprintf(toengine,"%s",limitCmd);
+	errorNumber=ENGINEOK;
+	return false;
+}
+
+bool
+WBEngine::SetSearchTime(int seconds)
+{
+	ClearNps();
+	searchDeadline=seconds*1000+GRACETIME;
+	snprintf(limitCmd,sizeof(limitCmd),"st %d\n",seconds);
+	fprintf(toengine,"%s",limitCmd);
+	errorNumber=ENGINEOK;
+	return false;
+}
+
+bool
+WBEngine::SetSearchTimeMs(int milliseconds)
+{
+	// st only takes whole seconds
+	return SetSearchTime(milliseconds<1000 ? 1 : (milliseconds+999)/1000);
+}
+
+bool
+WBEngine::SetSearchNodes(long long nodes)
+{
+	// with a node rate of N nodes per second, one second is N nodes
+	if (!fnps) {
+		errorNumber=ENGINENOTSUPP;
+		return true;
+	}
+	searchDeadline=0;
+	npsMode=true;
+	snprintf(limitCmd,sizeof(limitCmd),"nps %lld\nst 1\n",nodes);
+	fprintf(toengine,"%s",limitCmd);
+	errorNumber=ENGINEOK;
+	return false;
+}
+
+bool
+WBEngine::SetSearchLevel(int moves, int seconds, int inc)
+{
+	ClearNps();
+	searchDeadline=0;
+	if (seconds%60)
+		snprintf(limitCmd,sizeof(limitCmd),"level %d %d:%d %d\n",moves,seconds/60,seconds%60,inc);
+	else
+		snprintf(limitCmd,sizeof(limitCmd),"level %d %d %d\n",moves,seconds/60,inc);
+	fprintf(toengine,"%s",limitCmd);
+
+	errorNumber=ENGINEOK;
+	return false;
+}
+
+bool
+WBEngine::SetThreads(int n)
+{
+	if (!fsmp) {
+		errorNumber=ENGINENOTSUPP;
+		return true;
+	}
+	fprintf(toengine,"cores %d\n",n);
+	errorNumber=ENGINEOK;
+	return false;
+}
+
+bool
+WBEngine::SetTimeRemaining(int milliseconds)
+{
+	if (ftime) {
+		fprintf(toengine,"time %d\n",milliseconds/10);
+	}
+
+	errorNumber=ENGINEOK;
+	return false;
+}
+
+bool
+WBEngine::SetOppTimeRemaining (int milliseconds)
+{
+	if (ftime) {
+		fprintf(toengine,"otim %d\n",milliseconds/10);
+	}
+
+	errorNumber=ENGINEOK;
+	return false;
+}
+
+bool
+WBEngine::Search(int mode, searchPVFunction pvf, searchFRFunction frf, searchCMFunction cmf, searchRefFunction rf, searchStrFunction sf, int move)
+{
+	char cmd[1024];
+
+	if (!started) {
+		errorNumber=ENGINENOTSTARTED;
+		return true;
+	}
+
+	if (searching) {
+		errorNumber=ENGINEALREADYSEARCH;
+		return true;
+	}
+
+	// register handler functions.
+	if (frf==0) {
+		errorNumber=ENGINENOFRF;
+		return true;
+	}
+	finHandler=frf;
+	// rest is optional
+	pvHandler=pvf;
+	cmHandler=cmf;
+	refHandler=rf;
+	strHandler=sf;
+
+	// start search, the responses are handled by the reactor
+	if (PrepareSearch(cmd,sizeof(cmd)) || StartSearch())
+		return true;
+	if (Send(cmd))
+		return true;
+
+	errorNumber=ENGINEOK;
+	return false;
+}
+
+bool
+WBEngine::CanPipeline(void)
+{
+	// A refused setboard is only matched to its search by the ping that
+	// follows it. Without these a queued position could take the move of
+	// the previous one.
+	return fsetboard && fping;
+}
+
+bool
+WBEngine::PrepareSearch(char* cmd, int size)
+{
+	// The engine handles the commands in order: an Error for the setboard
+	// comes before the pong, the pong before the thinking output
+	int n=0;
+
+	if (fsetboard)
+		n+=snprintf(cmd,size,"setboard %s\n",fenPosition);
+	else {
+		// new forgets the search limit, the side to move is set by a move
+		// before entering edit mode
+		const char* stm=strchr(fenPosition,' ');
+
+		n+=snprintf(cmd,size,"new\nforce\n");
+		if (stm && stm[1]=='b')
+			n+=snprintf(cmd+n,size-n,"%s%s\n",fusermove ? "usermove " : "",fsan ? "a3" : "a2a3");
+		n+=EditCommands(fenPosition,cmd+n,size-n);
+		n+=snprintf(cmd+n,size-n,"%s",limitCmd);
+	}
+	if (fping)
+		n+=snprintf(cmd+n,size-n,"ping %d\n",++pingSeq);
+	snprintf(cmd+n,size-n,"go\n");
+
+	errorNumber=ENGINEOK;
+	return false;
+}
+
+int
+WBEngine::ResponseLine(char* buf)
+{
+	char *s, *next;
+	// analyze the engine response
+	//cout << buf << endl;
+	next=buf;
+	s=NextToken(&next," \t\n\r");
+	if (!s) return searchInfoNone;
+
+	if (strncmp(s,"move",4)==0) {
+		// played a move, call finHandler. The pong of this search has
+		// arrived before it.
+		int move;
+		s=NextToken(&next," \t\n\r");
+		move=s ? ParseMove(s) : 0;
+		if (rejectedPing==lastPong) {
+			// the move is not for the position that was asked
+			rejectedPing=-1;
+			errorNumber=ENGINEILLPOS;
+			FinishSearch(0,0);
+		} else
+			FinishSearch(move,0,s);
+		return searchInfoFinal;
+	}
+
+	if (strcmp(s,"pong")==0) {
+		s=NextToken(&next," \t\n\r");
+		if (s) lastPong=atoi(s);
+		return searchInfoNone;
+	}
+
+	if (strncmp(s,"Error",5)==0) {
+		// an illegal setboard belongs to the first ping not answered yet.
+		// Without ping lastPong stays put and the Error is of the current
+		// search, which is not pipelined then.
+		if (strstr(s,"setboard") || (next && strstr(next,"setboard")))
+			rejectedPing=fping ? lastPong+1 : lastPong;
+		return searchInfoNone;
+	}
+
+	// TODO: include other defined responses that could be sent here
+
+	if (isdigit(*s)) {
+		// thinking output: depth score time(centiseconds) nodes pv
+		int depth, score, time;
+		long long nodes;
+		depth=atoi(s);
+		s=NextToken(&next," \t\n\r"); score=s ? atoi(s) : 0;
+		s=NextToken(&next," \t\n\r"); time=s ? atoi(s)*10 : -1;
+		s=NextToken(&next," \t\n\r"); nodes=s ? atoll(s) : -1;
+		s=NextToken(&next,"\n\r");
+
+		ReportPV(0,depth,-1,score,time,nodes,-1,0,s ? s : "");
+		return searchInfoInformative;
+	}
+
+	return searchInfoNone;
+}
+
+bool
+WBEngine::SearchStop(void)
+{
+	if (!started) {
+		errorNumber=ENGINENOTSTARTED;
+		return true;
+	}
+
+	if (!searching) {
+		errorNumber=ENGINENOSEARCH;
+		return true;
+	}
+
+	fprintf(toengine,"?\n");
+
+	// response will follow via the registered FRhandler
+
+	errorNumber=ENGINEOK;
+	return false;
+}
+
+bool
+WBEngine::Stop(void)
+{
+	unsigned int i=0;
+	fprintf(toengine,"quit\n");
+
+	return WaitForStop();
+}
@@ -0,0 +1,158 @@
+// Epd.cpp
+//
+// Copyright (C) 2008-2013, ir. R.L. Pijl
+
+#include <string.h>
+
+#include "epd.h"
+
+static inline bool isBlank(char c)
+{
+	return c==' ' || c=='\t' || c=='\r';
+}
+
+EpdReader::EpdReader()
+{
+	data=0;
+	end=0;
+	cur=0;
+}
+
+EpdReader::~EpdReader()
+{
+	Close();
+}
+
+bool
+EpdReader::Open(const char* name)
+{
+	if (file.Open(name))
+		return true;
+	data=(const char*)file.GetData();
+	end=data+file.GetSize();
+	cur=data;
+	return false;
+}
+
+void
+EpdReader::Close(void)
+{
+	file.Close();
+	data=end=cur=0;
+}
+
+void
+EpdReader::Rewind(void)
+{
+	cur=data;
+}
+
+bool
+EpdReader::Next(epdLine_t* line)
+{
+	const char *start, *stop, *p;
+
+	do {
+		const char* nl;
+
+		if (cur>=end)
+			return false;
+		nl=(const char*)memchr(cur,'\n',end-cur);
+		start=cur;
+		stop=nl ? nl : end;
+		cur=nl ? nl+1 : end;
+
+		// trailing white space includes the '\r' of a DOS line ending
+		while (stop>start && isBlank(stop[-1]))
+			stop--;
+		while (start<stop && isBlank(*start))
+			start++;
+	} while (start==stop);
+
+	line->line.ptr=start;
+	line->line.length=(int)(stop-start);
+
+	p=start;
+	for (int k=0; k<4; k++) {
+		while (p<stop && isBlank(*p))
+			p++;
+		line->fen[k].ptr=p;
+		while (p<stop && !isBlank(*p))
+			p++;
+		line->fen[k].length=(int)(p-line->fen[k].ptr);
+	}
+	// fen strings with move counters are accepted as well
+	for (int k=0; k<2; k++) {
+		const char* q=p;
+
+		while (q<stop && isBlank(*q))
+			q++;
+		if (q==stop || *q<'0' || *q>'9')
+			break;
+		while (q<stop && *q>='0' && *q<='9')
+			q++;
+		if (q<stop && !isBlank(*q))
+			break;
+		p=q;
+	}
+	line->position.ptr=start;
+	line->position.length=(int)(p-start);
+
+	while (p<stop && isBlank(*p))
+		p++;
+	line->opcodes.ptr=p;
+	line->opcodes.length=(int)(stop-p);
+	return true;
+}
+
+int
+EpdReader::Count(void)
+{
+	const char* saved=cur;
+	epdLine_t line;
+	int n=0;
+
+	cur=data;
+	while (Next(&line))
+		n++;
+	cur=saved;
+	return n;
+}
+
+const char*
+FindOpcode(const epdLine_t* line, const char* opcode, field_t* operands)
+{
+	const char* p=line->opcodes.ptr;
+	const char* stop=p+line->opcodes.length;
+	int length=(int)strlen(opcode);
+
+	while (p<stop) {
+		const char *op, *q;
+		bool quoted=false;
+
+		while (p<stop && (isBlank(*p) || *p==';'))
+			p++;
+		op=p;
+		while (p<stop && !isBlank(*p) && *p!=';')
+			p++;
+		q=p;
+		while (q<stop && isBlank(*q))
+			q++;
+		operands->ptr=q;
+
+		// the operands end at a ';' that is not part of a string
+		while (q<stop && (quoted || *q!=';')) {
+			if (*q=='"')
+				quoted=!quoted;
+			q++;
+		}
+		operands->length=(int)(q-operands->ptr);
+		while (operands->length>0 && isBlank(operands->ptr[operands->length-1]))
+			operands->length--;
+
+		if (p-op==length && strncmp(op,opcode,length)==0)
+			return op;
+		p=q;
+	}
+	return 0;
+}
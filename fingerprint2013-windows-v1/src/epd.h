@@ -0,0 +1,54 @@
+// Epd.h
+// Zero-copy reader of epd-files through a memory mapping
+//
+// Copyright (C) 2008-2013, ir. R.L. Pijl
+
+#ifndef __EPD_H
+#define __EPD_H
+
+#include "platform.h"
+
+// A part of a line in the mapped file. It is not terminated by '\0'.
+typedef struct {
+	const char* ptr;
+	int length;
+} field_t;
+
+typedef struct {
+	field_t line;      // complete line without end of line
+	field_t fen[4];    // placement, side to move, castling and en passant
+	field_t position;  // the fen fields, including move counters if present
+	field_t opcodes;   // everything after the fen fields
+} epdLine_t;
+
+class EpdReader
+{
+public:
+	EpdReader();
+	virtual ~EpdReader();
+
+	// Returns true on error
+	bool Open(const char* name);
+	void Close(void);
+
+	// Next non-empty line, both DOS and Unix line endings are accepted.
+	// Returns false at the end of the file. The fields remain valid until
+	// the reader is closed.
+	bool Next(epdLine_t* line);
+	void Rewind(void);
+
+	// Number of non-empty lines in the file
+	int Count(void);
+
+private:
+	MappedFile file;
+	const char* data;
+	const char* end;
+	const char* cur;
+};
+
+// Find an opcode such as "bm" or "id" in the opcodes of a line. Returns the
+// start of the opcode and its operands up to the ';', or 0 when absent.
+const char* FindOpcode(const epdLine_t* line, const char* opcode, field_t* operands);
+
+#endif // __EPD_H
@@ -0,0 +1,194 @@
+// FPArchive.cpp
+//
+// Copyright (C) 2008-2013, ir. R.L. Pijl
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fparchive.h"
+
+FingerprintArchive::FingerprintArchive()
+{
+	header=0;
+	sketches=0;
+	moves=0;
+	names=0;
+	error="Ok";
+}
+
+FingerprintArchive::~FingerprintArchive()
+{
+	Close();
+}
+
+static unsigned long long mix(unsigned long long x)
+{
+	// the finaliser of splitmix64
+	x=(x ^ (x>>30))*0xBF58476D1CE4E5B9ULL;
+	x=(x ^ (x>>27))*0x94D049BB133111EBULL;
+	return x ^ (x>>31);
+}
+
+void
+FingerprintArchive::Sketch(const fpmove_t* m, int positions, fpmove_t* sketch)
+{
+	unsigned long long minimum[SKETCHSIZE];
+
+	memset(minimum,0xff,sizeof(minimum));
+	for (int i=0; i<positions; i++) {
+		unsigned long long h;
+
+		// a null move is no answer and not part of the set
+		if (!m[i]) continue;
+		h=mix(((unsigned long long)i<<16 | m[i])+0x9E3779B97F4A7C15ULL);
+		if (h<minimum[h%SKETCHSIZE])
+			minimum[h%SKETCHSIZE]=h;
+	}
+	// an empty bin is 0, which never counts as agreement
+	for (int b=0; b<SKETCHSIZE; b++)
+		sketch[b]=minimum[b]==~0ULL ? 0 : (fpmove_t)((minimum[b]>>40) | 1);
+}
+
+bool
+FingerprintArchive::Save(FingerprintSet* set, const char* name, const char** error)
+{
+	faheader_t h;
+	fpmove_t sketch[SKETCHSIZE];
+	FILE* fp;
+	bool rv=false;
+
+	memset(&h,0,sizeof(h));
+	memcpy(h.magic,FAMAGIC,4);
+	h.version=FAVERSION;
+	h.count=set->GetCount();
+	h.positions=set->GetPositions();
+	h.stride=set->GetStride();
+	h.sketchSize=SKETCHSIZE;
+	h.suiteHash=set->GetSuiteHash();
+	h.namesOffset=sizeof(h)+(unsigned long long)h.count*(SKETCHSIZE+h.stride)*sizeof(fpmove_t);
+
+	fp=fopen(name,"wb");
+	if (!fp) {
+		*error="Could not create the archive";
+		return true;
+	}
+	rv=fwrite(&h,sizeof(h),1,fp)!=1;
+	for (unsigned int i=0; i<h.count && !rv; i++) {
+		Sketch(set->GetMoves(i),h.positions,sketch);
+		rv=fwrite(sketch,sizeof(fpmove_t),SKETCHSIZE,fp)!=SKETCHSIZE;
+	}
+	for (unsigned int i=0; i<h.count && !rv; i++)
+		rv=fwrite(set->GetMoves(i),sizeof(fpmove_t),h.stride,fp)!=h.stride;
+	for (unsigned int i=0; i<h.count && !rv; i++)
+		rv=fwrite(set->GetName(i),strlen(set->GetName(i))+1,1,fp)!=1;
+	if (fclose(fp) || rv) {
+		*error="Could not write the archive";
+		return true;
+	}
+	return false;
+}
+
+bool
+FingerprintArchive::Open(const char* name)
+{
+	size_t size;
+	const char* s;
+	const char* end;
+
+	Close();
+	if (file.Open(name)) {
+		error="Could not open the archive";
+		return true;
+	}
+	header=(const faheader_t*)file.GetData();
+	size=file.GetSize();
+	if (size<sizeof(faheader_t) || memcmp(header->magic,FAMAGIC,4)
+	 || header->version!=FAVERSION || header->sketchSize!=SKETCHSIZE) {
+		error="Not a fingerprint archive";
+		Close();
+		return true;
+	}
+	if (size<header->namesOffset) {
+		error="Fingerprint archive is truncated";
+		Close();
+		return true;
+	}
+	sketches=(const fpmove_t*)(header+1);
+	moves=sketches+(size_t)header->count*SKETCHSIZE;
+
+	// the names are the only part that is not of a fixed size
+	names=(const char**)malloc((header->count+1)*sizeof(char*));
+	s=(const char*)header+header->namesOffset;
+	end=(const char*)header+size;
+	for (unsigned int i=0; i<header->count; i++) {
+		const char* z=(const char*)memchr(s,'\0',end-s);
+
+		if (!z) {
+			error="Fingerprint archive is truncated";
+			Close();
+			return true;
+		}
+		names[i]=s;
+		s=z+1;
+	}
+	return false;
+}
+
+void
+FingerprintArchive::Close(void)
+{
+	free(names);
+	names=0;
+	header=0;
+	sketches=moves=0;
+	file.Close();
+}
+
+int
+FingerprintArchive::GetCount(void)
+{
+	return header ? header->count : 0;
+}
+
+int
+FingerprintArchive::GetPositions(void)
+{
+	return header ? header->positions : 0;
+}
+
+int
+FingerprintArchive::GetStride(void)
+{
+	return header ? header->stride : 0;
+}
+
+unsigned long long
+FingerprintArchive::GetSuiteHash(void)
+{
+	return header ? header->suiteHash : 0;
+}
+
+const char*
+FingerprintArchive::GetName(int i)
+{
+	return names[i];
+}
+
+const fpmove_t*
+FingerprintArchive::GetMoves(int i)
+{
+	return moves+(size_t)i*header->stride;
+}
+
+const fpmove_t*
+FingerprintArchive::GetSketch(int i)
+{
+	return sketches+(size_t)i*SKETCHSIZE;
+}
+
+const char*
+FingerprintArchive::GetErrorStr(void)
+{
+	return error;
+}
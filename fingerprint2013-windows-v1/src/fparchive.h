@@ -0,0 +1,70 @@
+// FPArchive.h
+// Archive of many fingerprints of one suite for nearest-neighbour queries
+//
+// Copyright (C) 2008-2013, ir. R.L. Pijl
+
+#ifndef __FPARCHIVE_H
+#define __FPARCHIVE_H
+
+#include "fpset.h"
+#include "platform.h"
+
+// The archive is this header, the sketches of all fingerprints, their moves
+// as rows of 'stride' 16-bit codes, and their names as '\0'-terminated
+// strings, all in the byte order of the machine. It is used straight from a
+// memory mapping.
+#define FAMAGIC "CSFA"
+#define FAVERSION 1
+
+typedef struct {
+	char magic[4];
+	unsigned int version;
+	unsigned int count;
+	unsigned int positions;
+	unsigned int stride;
+	unsigned int sketchSize;
+	unsigned long long suiteHash;
+	unsigned long long namesOffset;
+} faheader_t;
+
+// A sketch is a one permutation MinHash of the (position, move) pairs of a
+// fingerprint: every pair is hashed once into one of SKETCHSIZE bins, which
+// keep 16 bits of their smallest hash. The fraction of equal bins of two
+// sketches estimates the Jaccard similarity of the pairs, which grows with
+// the agreement of the fingerprints.
+class FingerprintArchive
+{
+public:
+	FingerprintArchive();
+	virtual ~FingerprintArchive();
+
+	enum { SKETCHSIZE=256 };
+
+	static void Sketch(const fpmove_t* moves, int positions, fpmove_t* sketch);
+
+	// Write all fingerprints of the set. Returns true on error.
+	static bool Save(FingerprintSet* set, const char* name, const char** error);
+
+	bool Open(const char* name);
+	void Close(void);
+
+	int GetCount(void);
+	int GetPositions(void);
+	int GetStride(void);
+	unsigned long long GetSuiteHash(void);
+	const char* GetName(int i);
+	const fpmove_t* GetMoves(int i);
+	const fpmove_t* GetSketch(int i);
+
+	const char* GetErrorStr(void);
+
+private:
+	MappedFile file;
+	const faheader_t* header;
+	const fpmove_t* sketches;
+	const fpmove_t* moves;
+	const char** names;
+	const char* error;
+};
+
+#endif // __FPARCHIVE_H
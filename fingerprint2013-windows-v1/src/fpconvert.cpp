@@ -0,0 +1,64 @@
+// fpconvert.cpp
+// Conversion between epd and binary fingerprints
+//
+// Copyright (C) 2013, ir. R.L. Pijl
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fpset.h"
+
+static void usage(void)
+{
+	printf("Usage: fpconvert [-suite <epd-file>] <input> <output>\n\n");
+	printf("  -suite <epd-file>  positions of the fingerprint (default simcsvn1.dos.epd)\n\n");
+	printf("The input is either an epd or a binary fingerprint. An output file ending\n");
+	printf("in .epd is written as epd-file using the positions of the suite, any other\n");
+	printf("output file in the binary format.\n");
+}
+
+int main(int argc, char* argv[])
+{
+	FingerprintSet fingerprint;
+	const char* suite="simcsvn1.dos.epd";
+	const char* input=0;
+	const char* output=0;
+	size_t length;
+	bool rv;
+
+	for (int a=1; a<argc; a++) {
+		if (strcmp(argv[a],"-suite")==0 && a+1<argc) {
+			suite=argv[++a];
+			continue;
+		}
+		if (*argv[a]=='-' || output) {
+			usage();
+			return 1;
+		}
+		if (input)
+			output=argv[a];
+		else
+			input=argv[a];
+	}
+	if (!output) {
+		usage();
+		return 1;
+	}
+
+	if (fingerprint.Load(input)) {
+		fprintf(stderr,"ERROR: %s: %s\n",input,fingerprint.GetErrorStr());
+		return 1;
+	}
+
+	length=strlen(output);
+	if (length>4 && strcmp(output+length-4,".epd")==0)
+		rv=fingerprint.SaveEPD(0,suite,output);
+	else
+		rv=fingerprint.SaveBinary(0,output);
+	if (rv) {
+		fprintf(stderr,"ERROR: %s: %s\n",output,fingerprint.GetErrorStr());
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,318 @@
+// FPSet.cpp
+//
+// Copyright (C) 2008-2013, ir. R.L. Pijl
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_IX86)
+#include <emmintrin.h>
+#define FP_SSE2
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#include "epd.h"
+#include "fpset.h"
+#include "platform.h"
+#include "util.h"
+
+static inline int popCount(unsigned int x)
+{
+#ifdef _MSC_VER
+	return __popcnt(x);
+#else
+	return __builtin_popcount(x);
+#endif
+}
+
+unsigned long long SuiteHashLine(unsigned long long hash, const char* line, int length)
+{
+	// FNV-1a, every line is terminated by a newline
+	for (int i=0; i<length; i++) {
+		hash^=(unsigned char)line[i];
+		hash*=1099511628211ULL;
+	}
+	hash^='\n';
+	return hash*1099511628211ULL;
+}
+
+int MoveAgreement(const fpmove_t* a, const fpmove_t* b, int n)
+{
+	int same=0;
+
+#ifdef FP_SSE2
+	// 8 moves per compare, a null move never counts as agreement
+	const __m128i zero=_mm_setzero_si128();
+
+	for (int i=0; i<n; i+=16) {
+		__m128i a0=_mm_loadu_si128((const __m128i*)(a+i));
+		__m128i a1=_mm_loadu_si128((const __m128i*)(a+i+8));
+		__m128i eq0=_mm_andnot_si128(_mm_cmpeq_epi16(a0,zero),
+			_mm_cmpeq_epi16(a0,_mm_loadu_si128((const __m128i*)(b+i))));
+		__m128i eq1=_mm_andnot_si128(_mm_cmpeq_epi16(a1,zero),
+			_mm_cmpeq_epi16(a1,_mm_loadu_si128((const __m128i*)(b+i+8))));
+
+		// packed to one mask bit per move
+		same+=popCount(_mm_movemask_epi8(_mm_packs_epi16(eq0,eq1)));
+	}
+#else
+	for (int i=0; i<n; i++)
+		if (a[i] && a[i]==b[i]) same++;
+#endif
+	return same;
+}
+
+FingerprintSet::FingerprintSet()
+{
+	moves=0;
+	names=0;
+	count=0;
+	capacity=0;
+	positions=-1;
+	stride=0;
+	suiteHash=0;
+	error="Ok";
+}
+
+FingerprintSet::~FingerprintSet()
+{
+	for (int i=0; i<count; i++)
+		free(names[i]);
+	free(names);
+	free(moves);
+}
+
+bool
+FingerprintSet::AddFingerprint(const char* name, const fpmove_t* m, int n, unsigned long long hash)
+{
+	if (positions<0) {
+		positions=n;
+		stride=(n+15)&~15;
+		suiteHash=hash;
+	}
+	if (n!=positions) {
+		error="Fingerprint has a different number of positions";
+		return true;
+	}
+	if (hash!=suiteHash) {
+		error="Fingerprint is of another position suite";
+		return true;
+	}
+	if (count==capacity) {
+		int grown=capacity ? 2*capacity : 16;
+		fpmove_t* gm=(fpmove_t*)realloc(moves,(size_t)grown*stride*sizeof(fpmove_t));
+		char** gn=(char**)realloc(names,grown*sizeof(char*));
+
+		if (gm) moves=gm;
+		if (gn) names=gn;
+		if (!gm || !gn) {
+			error="Could not allocate more memory";
+			return true;
+		}
+		capacity=grown;
+	}
+	fpmove_t* row=moves+(size_t)count*stride;
+
+	memcpy(row,m,n*sizeof(fpmove_t));
+	memset(row+n,0,(stride-n)*sizeof(fpmove_t));
+	names[count++]=strdup(name);
+	return false;
+}
+
+bool
+FingerprintSet::LoadEPD(const char* name)
+{
+	EpdReader epd;
+	epdLine_t line;
+	fpmove_t* m;
+	int n=0;
+	unsigned long long hash=SUITEHASHINIT;
+	bool rv;
+
+	if (epd.Open(name)) {
+		error="Could not open the fingerprint";
+		return true;
+	}
+	m=(fpmove_t*)malloc((epd.Count()+1)*sizeof(fpmove_t));
+	if (!m) {
+		error="Could not allocate more memory";
+		return true;
+	}
+	while (epd.Next(&line)) {
+		field_t bm;
+		char move[6];
+
+		// positions without a best move are kept as a null move
+		m[n]=0;
+		if (FindOpcode(&line,"bm",&bm) && bm.length>=4) {
+			int length=bm.length<5 ? bm.length : 5;
+
+			memcpy(move,bm.ptr,length);
+			move[length]='\0';
+			m[n]=(fpmove_t)ParseMove(move);
+		}
+		n++;
+		hash=SuiteHashLine(hash,line.position.ptr,line.position.length);
+	}
+
+	rv=AddFingerprint(name,m,n,hash);
+	free(m);
+	return rv;
+}
+
+bool
+FingerprintSet::LoadBinary(const char* name)
+{
+	MappedFile file;
+	const fpheader_t* header;
+
+	if (file.Open(name)) {
+		error="Could not open the fingerprint";
+		return true;
+	}
+	header=(const fpheader_t*)file.GetData();
+	if (file.GetSize()<sizeof(fpheader_t) || memcmp(header->magic,FPMAGIC,4)
+	 || header->version!=FPVERSION) {
+		error="Not a binary fingerprint";
+		return true;
+	}
+	if (file.GetSize()<sizeof(fpheader_t)+header->positions*sizeof(fpmove_t)) {
+		error="Binary fingerprint is truncated";
+		return true;
+	}
+	// the moves are copied straight from the mapping into the padded row
+	return AddFingerprint(name,(const fpmove_t*)(header+1),header->positions,header->suiteHash);
+}
+
+bool
+FingerprintSet::Load(const char* name)
+{
+	char magic[4];
+	FILE* fp=fopen(name,"rb");
+	bool binary;
+
+	if (!fp) {
+		error="Could not open the fingerprint";
+		return true;
+	}
+	binary=fread(magic,1,4,fp)==4 && memcmp(magic,FPMAGIC,4)==0;
+	fclose(fp);
+	return binary ? LoadBinary(name) : LoadEPD(name);
+}
+
+bool
+FingerprintSet::SaveBinary(int i, const char* name)
+{
+	fpheader_t header;
+	FILE* fp;
+	bool rv;
+
+	memset(&header,0,sizeof(header));
+	memcpy(header.magic,FPMAGIC,4);
+	header.version=FPVERSION;
+	header.positions=positions;
+	header.suiteHash=suiteHash;
+
+	fp=fopen(name,"wb");
+	if (!fp) {
+		error="Could not create the fingerprint";
+		return true;
+	}
+	rv=fwrite(&header,sizeof(header),1,fp)!=1
+	 || fwrite(GetMoves(i),sizeof(fpmove_t),positions,fp)!=(size_t)positions;
+	if (fclose(fp) || rv) {
+		error="Could not write the fingerprint";
+		return true;
+	}
+	return false;
+}
+
+bool
+FingerprintSet::SaveEPD(int i, const char* suite, const char* name)
+{
+	EpdReader epd;
+	epdLine_t line;
+	FILE* out;
+	const fpmove_t* m=GetMoves(i);
+	unsigned long long hash=SUITEHASHINIT;
+	int n=0;
+
+	if (epd.Open(suite)) {
+		error="Could not open the position suite";
+		return true;
+	}
+	// the suite is checked first, an existing file is only replaced by a
+	// fingerprint of the right positions
+	while (epd.Next(&line)) {
+		hash=SuiteHashLine(hash,line.position.ptr,line.position.length);
+		n++;
+	}
+	if (n!=positions || hash!=suiteHash) {
+		error="Fingerprint is of another position suite";
+		return true;
+	}
+	epd.Rewind();
+
+	out=fopen(name,"w");
+	if (!out) {
+		error="Could not create the fingerprint";
+		return true;
+	}
+	for (n=0; epd.Next(&line); n++)
+		fprintf(out,"%.*s bm %s\n",line.position.length,line.position.ptr,MoveStr(m[n]));
+	if (fclose(out)) {
+		error="Could not write the fingerprint";
+		return true;
+	}
+	return false;
+}
+
+int
+FingerprintSet::GetCount(void)
+{
+	return count;
+}
+
+int
+FingerprintSet::GetPositions(void)
+{
+	return positions<0 ? 0 : positions;
+}
+
+const char*
+FingerprintSet::GetName(int i)
+{
+	return names[i];
+}
+
+const fpmove_t*
+FingerprintSet::GetMoves(int i)
+{
+	return moves+(size_t)i*stride;
+}
+
+int
+FingerprintSet::GetStride(void)
+{
+	return stride;
+}
+
+unsigned long long
+FingerprintSet::GetSuiteHash(void)
+{
+	return suiteHash;
+}
+
+int
+FingerprintSet::Agreement(int a, int b)
+{
+	return MoveAgreement(GetMoves(a),GetMoves(b),stride);
+}
+
+const char*
+FingerprintSet::GetErrorStr(void)
+{
+	return error;
+}
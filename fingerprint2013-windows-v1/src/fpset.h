@@ -0,0 +1,79 @@
+// FPSet.h
+// A set of fingerprints of the same position suite, kept as 16-bit moves
+//
+// Copyright (C) 2008-2013, ir. R.L. Pijl
+
+#ifndef __FPSET_H
+#define __FPSET_H
+
+typedef unsigned short fpmove_t;
+
+// Binary fingerprint: this header followed by the moves as 16-bit ParseMove
+// codes in the byte order of the machine (little endian on all targets), one
+// per position of the suite. The suite hash over the fen fields identifies the
+// positions, so the epd-file can be rebuilt from the suite.
+#define FPMAGIC "CSFP"
+#define FPVERSION 1
+
+typedef struct {
+	char magic[4];
+	unsigned int version;
+	unsigned int positions;
+	unsigned int reserved;
+	unsigned long long suiteHash;
+} fpheader_t;
+
+class FingerprintSet
+{
+public:
+	FingerprintSet();
+	virtual ~FingerprintSet();
+
+	// Add the fingerprint in an epd file with 'bm' opcodes. All fingerprints
+	// must have the same number of positions. Returns true on error.
+	bool LoadEPD(const char* name);
+	bool LoadBinary(const char* name);
+	// Either of the above, depending on the contents of the file
+	bool Load(const char* name);
+
+	// Write fingerprint i in the binary format, or as epd-file using the
+	// positions of the suite. Return true on error.
+	bool SaveBinary(int i, const char* name);
+	bool SaveEPD(int i, const char* suite, const char* name);
+
+	int GetCount(void);
+	int GetPositions(void);
+	const char* GetName(int i);
+
+	// The moves of fingerprint i, padded with zeroes to GetStride() entries
+	const fpmove_t* GetMoves(int i);
+	int GetStride(void);
+	unsigned long long GetSuiteHash(void);
+
+	// Number of positions where both fingerprints have the same (non-null) move
+	int Agreement(int a, int b);
+
+	const char* GetErrorStr(void);
+
+protected:
+	bool AddFingerprint(const char* name, const fpmove_t* m, int n, unsigned long long hash);
+
+private:
+	fpmove_t* moves;
+	char** names;
+	int count;
+	int capacity;
+	int positions;
+	int stride;
+	unsigned long long suiteHash;
+	const char* error;
+};
+
+// Hash of the positions of a suite, one fen at a time
+#define SUITEHASHINIT 14695981039346656037ULL
+unsigned long long SuiteHashLine(unsigned long long hash, const char* line, int length);
+
+// Agreement between two rows of n moves, n a multiple of 16
+int MoveAgreement(const fpmove_t* a, const fpmove_t* b, int n);
+
+#endif // __FPSET_H
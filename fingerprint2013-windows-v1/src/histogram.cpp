@@ -0,0 +1,123 @@
+// Histogram.cpp
+//
+// Copyright (C) 2008-2013, ir. R.L. Pijl
+
+#include <string.h>
+
+#include "histogram.h"
+
+Histogram::Histogram()
+{
+	memset(counts,0,sizeof(counts));
+	count=0;
+	total=0;
+	min=0;
+	max=0;
+}
+
+int
+Histogram::Index(long long value)
+{
+	int e=0;
+
+	if (value<LINEAR)
+		return (int)value;
+	while ((value>>e)>1)
+		e++;
+	// e is the highest bit set, the next SUBBITS bits select the sub-bucket
+	return LINEAR+(e-SUBBITS-1)*(1<<SUBBITS)+(int)(value>>(e-SUBBITS))-(1<<SUBBITS);
+}
+
+long long
+Histogram::HighestEquivalent(int index)
+{
+	int e, sub;
+
+	if (index<LINEAR)
+		return index;
+	e=(index-LINEAR)/(1<<SUBBITS)+SUBBITS+1;
+	sub=(index-LINEAR)%(1<<SUBBITS)+(1<<SUBBITS);
+	return (((long long)sub+1)<<(e-SUBBITS))-1;
+}
+
+void
+Histogram::Record(long long value)
+{
+	if (value<0)
+		return;
+	if (count==0 || value<min) min=value;
+	if (count==0 || value>max) max=value;
+	counts[Index(value)]++;
+	count++;
+	total+=value;
+}
+
+long long
+Histogram::GetCount(void)
+{
+	return count;
+}
+
+long long
+Histogram::GetMin(void)
+{
+	return min;
+}
+
+long long
+Histogram::GetMax(void)
+{
+	return max;
+}
+
+double
+Histogram::GetMean(void)
+{
+	return count ? (double)total/count : 0.0;
+}
+
+long long
+Histogram::GetTotal(void)
+{
+	return total;
+}
+
+long long
+Histogram::ValueAtPercentile(double p)
+{
+	long long target, seen=0;
+
+	if (count==0)
+		return 0;
+	target=(long long)(p/100.0*count+0.5);
+	if (target<1) target=1;
+	for (int i=0; i<BUCKETS; i++) {
+		seen+=counts[i];
+		if (seen>=target) {
+			long long v=HighestEquivalent(i);
+
+			return v<max ? v : max;
+		}
+	}
+	return max;
+}
+
+void
+Histogram::Print(FILE* fp, const char* title, double scale, const char* unit)
+{
+	static const double percentiles[]={ 0.0, 50.0, 75.0, 90.0, 95.0, 99.0, 99.9, 100.0 };
+
+	fprintf(fp,"%s\n",title);
+	fprintf(fp,"%14s %12s %10s\n",unit,"Percentile","TotalCount");
+	for (unsigned i=0; i<sizeof(percentiles)/sizeof(percentiles[0]); i++) {
+		double p=percentiles[i];
+		long long v=p==0.0 ? min : ValueAtPercentile(p);
+		long long below=0;
+
+		// number of values up to and including v's bucket
+		for (int k=0; k<=Index(v) && k<BUCKETS; k++)
+			below+=counts[k];
+		fprintf(fp,"%14.3f %12.6f %10lld\n",v/scale,p/100.0,below);
+	}
+	fprintf(fp,"#[Mean = %.3f, Max = %.3f, Total count = %lld]\n",GetMean()/scale,max/scale,count);
+}
@@ -0,0 +1,46 @@
+// Histogram.h
+// Log-linear latency histogram in the style of HdrHistogram
+//
+// Copyright (C) 2008-2013, ir. R.L. Pijl
+
+#ifndef __HISTOGRAM_H
+#define __HISTOGRAM_H
+
+#include <stdio.h>
+
+// Values below 64 are counted exactly, larger values in 32 buckets per power
+// of two, so every value is kept within about 3%. Not thread-safe.
+class Histogram
+{
+public:
+	Histogram();
+
+	// Negative values (not measured) are ignored
+	void Record(long long value);
+
+	long long GetCount(void);
+	long long GetMin(void);
+	long long GetMax(void);
+	double GetMean(void);
+	long long GetTotal(void);
+
+	// Highest value equivalent to the one at percentile p (0-100)
+	long long ValueAtPercentile(double p);
+
+	// Percentile distribution, values divided by scale (e.g. 1000 for us->ms)
+	void Print(FILE* fp, const char* title, double scale, const char* unit);
+
+private:
+	enum { SUBBITS=5, LINEAR=2<<SUBBITS, BUCKETS=LINEAR+(64-SUBBITS-1)*(1<<SUBBITS) };
+
+	long long counts[BUCKETS];
+	long long count;
+	long long total;
+	long long min;
+	long long max;
+
+	int Index(long long value);
+	long long HighestEquivalent(int index);
+};
+
+#endif // __HISTOGRAM_H
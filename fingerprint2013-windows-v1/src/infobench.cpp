@@ -0,0 +1,149 @@
+// infobench.cpp
+// Benchmark of the UCI info parser against the former strtok based parser
+//
+// Copyright (C) 2013, ir. R.L. Pijl
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "platform.h"
+#include "uciinfo.h"
+
+#define LINES 4096
+
+// The parser as it was in UCIEngine::ResponseLine, kept for comparison
+static long long strtokParse(char* buf, int* depth, int* score)
+{
+	char* s;
+	int multi=0, seldepth=-1, time=-1, nodes=-1, tbhits=-1, hashfull=0;
+
+	*depth=-1;
+	*score=0;
+	s=strtok(buf," \t\n\r");
+	if (!s || strncmp(s,"info",4)) return -1;
+	while ((s=strtok(0," \n\r\t"))) {
+		if (strncmp(s,"multi",5)==0) {
+			s=strtok(0," \n\r\t");
+			multi=atoi(s);
+			continue;
+		}
+		if (strncmp(s,"depth",5)==0) {
+			s=strtok(0," \n\r\t");
+			*depth=atoi(s);
+			continue;
+		}
+		if (strncmp(s,"seldepth",8)==0) {
+			s=strtok(0," \n\r\t");
+			seldepth=atoi(s);
+			continue;
+		}
+		if (strncmp(s,"score",5)==0) {
+			s=strtok(0," \n\r\t");
+			if (strncmp(s,"cp",2)==0) {
+				s=strtok(0," \n\r\t");
+				*score=atoi(s);
+				continue;
+			}
+			if (strncmp(s,"mate",4)==0) {
+				s=strtok(0," \n\r\t");
+				*score=atoi(s);
+				if (*score>0)
+					*score=100000-*score;
+				if (*score<0)
+					*score=-100000-*score;
+				continue;
+			}
+			continue;
+		}
+		if (strncmp(s,"time",4)==0) {
+			s=strtok(0," \n\r\t");
+			time=atoi(s);
+			continue;
+		}
+		if (strncmp(s,"nodes",5)==0) {
+			s=strtok(0," \n\r\t");
+			nodes=atoi(s);
+			continue;
+		}
+		if (strncmp(s,"tbhits",6)==0) {
+			s=strtok(0," \n\r\t");
+			tbhits=atoi(s);
+			continue;
+		}
+		if (strncmp(s,"hashfull",8)==0) {
+			s=strtok(0," \n\r\t");
+			hashfull=atoi(s);
+			continue;
+		}
+		if (strncmp(s,"pv",2)==0) {
+			s=strtok(0,"\n\r");
+			break;
+		}
+	}
+	return nodes+multi+seldepth+time+tbhits+hashfull;
+}
+
+int main(int argc, char* argv[])
+{
+	static char lines[LINES][256];
+	char buf[256];
+	int rounds=argc>1 ? atoi(argv[1]) : 200;
+	unsigned long long start, strtokMs, parserMs;
+	long long check=0;
+	int mismatches=0;
+
+	// a mix of the lines a multipv analysis produces
+	srand(1);
+	for (int i=0; i<LINES; i++) {
+		int depth=1+rand()%30;
+
+		if (i%4==3)
+			sprintf(lines[i],"info depth %d currmove e2e4 currmovenumber %d\n",depth,1+rand()%40);
+		else
+			sprintf(lines[i],"info depth %d seldepth %d multipv %d score %s %d nodes %d nps %d "
+				"hashfull %d tbhits 0 time %d pv e2e4 e7e5 g1f3 b8c6 f1b5 a7a6\n",
+				depth,depth+rand()%10,1+i%4,i%50 ? "cp" : "mate",rand()%400-200,
+				rand(),rand()%3000000,rand()%1000,rand()%100000);
+	}
+
+	start=TimeMs();
+	for (int r=0; r<rounds; r++)
+		for (int i=0; i<LINES; i++) {
+			int depth, score;
+
+			strcpy(buf,lines[i]);
+			check+=strtokParse(buf,&depth,&score)+depth+score;
+		}
+	strtokMs=TimeMs()-start;
+
+	start=TimeMs();
+	for (int r=0; r<rounds; r++)
+		for (int i=0; i<LINES; i++) {
+			uciInfo_t info;
+
+			// same copy as above, the engine hands over its own buffer as well
+			strcpy(buf,lines[i]);
+			ParseUCIInfo(buf+4,&info);
+			check+=info.nodes+info.depth+info.score;
+		}
+	parserMs=TimeMs()-start;
+
+	for (int i=0; i<LINES; i++) {
+		uciInfo_t info;
+		int depth, score;
+
+		strcpy(buf,lines[i]);
+		strtokParse(buf,&depth,&score);
+		ParseUCIInfo(lines[i]+4,&info);
+		if (depth!=info.depth || score!=info.score)
+			mismatches++;
+	}
+
+	printf("%d lines x %d rounds (checksum %lld)\n",LINES,rounds,check);
+	printf("strtok parser:  %llu ms, %.0f ns/line\n",strtokMs,1e6*strtokMs/((double)LINES*rounds));
+	printf("single pass:    %llu ms, %.0f ns/line\n",parserMs,1e6*parserMs/((double)LINES*rounds));
+	if (mismatches)
+		printf("ERROR: %d lines parsed differently\n",mismatches);
+	return mismatches!=0;
+}
@@ -0,0 +1,250 @@
+// Journal.cpp
+//
+// Copyright (C) 2008-2013, ir. R.L. Pijl
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "journal.h"
+#include "util.h"
+
+// The first line is 'journal <positions> <suite hash> <settings digest>',
+// every other line holds '<position index> <move>', followed by the ranked
+// moves of a multipv search if there were any. A line that was only partly
+// written when the run was interrupted is closed with '!', which makes it
+// invalid, before new results are appended.
+
+Journal::Journal()
+{
+	fp=0;
+	moves=0;
+	top=0;
+	topCount=0;
+	done=0;
+	positions=0;
+	doneCount=0;
+	unsynced=0;
+	error="Ok";
+}
+
+Journal::~Journal()
+{
+	Close();
+	if (moves)
+		delete[] moves;
+	if (top)
+		delete[] top;
+	if (topCount)
+		delete[] topCount;
+	if (done)
+		delete[] done;
+}
+
+static bool validMove(const char* s)
+{
+	size_t n=strlen(s);
+
+	return (n==4 || (n==5 && strchr("qrbn",s[4])))
+		&& s[0]>='a' && s[0]<='h' && s[1]>='1' && s[1]<='8'
+		&& s[2]>='a' && s[2]<='h' && s[3]>='1' && s[3]<='8';
+}
+
+static void makeHeader(char* buf, int size, int positions, unsigned long long suiteHash, const unsigned char* settings)
+{
+	int n=snprintf(buf,size,"journal %d %016llx ",positions,suiteHash);
+
+	// the settings are unknown when the engine executable could not be read
+	if (settings) {
+		for (int i=0; i<Sha256::DIGESTSIZE; i++)
+			n+=snprintf(buf+n,size-n,"%02x",settings[i]);
+	} else
+		n+=snprintf(buf+n,size-n,"-");
+	snprintf(buf+n,size-n,"\n");
+}
+
+static bool sameHeader(const char* a, const char* b)
+{
+	// equal, or only one of them knows the settings
+	const char* sa=strrchr(a,' ');
+	const char* sb=strrchr(b,' ');
+
+	if (sa-a!=sb-b || strncmp(a,b,sa-a))
+		return false;
+	return strcmp(sa," -\n")==0 || strcmp(sb," -\n")==0 || strcmp(sa,sb)==0;
+}
+
+bool
+Journal::ParseLine(char* line)
+{
+	char *s, *next=line;
+	int index, m, t[MAXTOP], n=0;
+
+	s=NextToken(&next," \t\n\r");
+	if (!s || strspn(s,"0123456789")!=strlen(s))
+		return true;
+	index=atoi(s);
+	s=NextToken(&next," \t\n\r");
+	if (!s || !validMove(s) || index>=positions)
+		return true;
+	m=ParseMove(s);
+	while ((s=NextToken(&next," \t\n\r"))) {
+		if (n==MAXTOP || !validMove(s))
+			return true;
+		t[n++]=ParseMove(s);
+	}
+	if (!done[index])
+		doneCount++;
+	done[index]=true;
+	moves[index]=m;
+	memcpy(top+index*MAXTOP,t,n*sizeof(int));
+	topCount[index]=(unsigned char)n;
+	return false;
+}
+
+bool
+Journal::Open(const char* name, int n, unsigned long long suiteHash, const unsigned char* settings)
+{
+	char buf[256], header[128];
+	FILE* old;
+	bool empty=true, terminated=true;
+
+	positions=n;
+	moves=new int[positions];
+	top=new int[positions*MAXTOP];
+	topCount=new unsigned char[positions];
+	done=new bool[positions];
+	memset(done,0,positions*sizeof(bool));
+	memset(topCount,0,positions);
+	doneCount=0;
+	makeHeader(header,sizeof(header),positions,suiteHash,settings);
+
+	old=fopen(name,"r");
+	if (old) {
+		while (fgets(buf,sizeof(buf),old)) {
+			if (!strchr(buf,'\n')) {
+				terminated=false;
+				break;
+			}
+			if (empty) {
+				// the results are only of use for the same positions and engine
+				if (strncmp(buf,"journal ",8) || !sameHeader(buf,header)) {
+					fclose(old);
+					error="The journal is of other positions or engine settings";
+					return true;
+				}
+				empty=false;
+				continue;
+			}
+			ParseLine(buf);
+		}
+		fclose(old);
+	}
+
+	// a journal without a complete header is started again
+	fp=fopen(name,empty ? "w" : "a");
+	if (!fp) {
+		error="Could not open the journal";
+		return true;
+	}
+	if (empty)
+		fputs(header,fp);
+	else if (!terminated)
+		fputs("!\n",fp);
+	if (Sync()) {
+		error="Could not write to the journal";
+		return true;
+	}
+	return false;
+}
+
+bool
+Journal::Close(void)
+{
+	bool rv=false;
+
+	if (fp) {
+		rv=Sync();
+		fclose(fp);
+		fp=0;
+	}
+	return rv;
+}
+
+bool
+Journal::IsDone(int index)
+{
+	return index>=0 && index<positions && done[index];
+}
+
+int
+Journal::GetMove(int index)
+{
+	return IsDone(index) ? moves[index] : 0;
+}
+
+int
+Journal::GetDoneCount(void)
+{
+	return doneCount;
+}
+
+int
+Journal::GetTopMoves(int index, int* m, int size)
+{
+	int n;
+
+	if (!IsDone(index))
+		return 0;
+	n=topCount[index]<size ? topCount[index] : size;
+	memcpy(m,top+index*MAXTOP,n*sizeof(int));
+	return n;
+}
+
+bool
+Journal::Append(int index, int move, const int* t, int n)
+{
+	if (!fp || index<0 || index>=positions)
+		return true;
+	if (!done[index])
+		doneCount++;
+	done[index]=true;
+	moves[index]=move;
+	if (n>MAXTOP) n=MAXTOP;
+	memcpy(top+index*MAXTOP,t,n*sizeof(int));
+	topCount[index]=(unsigned char)n;
+
+	fprintf(fp,"%d %s",index,MoveStr(move));
+	for (int i=0; i<n; i++)
+		fprintf(fp," %s",MoveStr(t[i]));
+	fprintf(fp,"\n");
+	if (++unsynced>=SYNCINTERVAL)
+		return Sync();
+	return false;
+}
+
+const char*
+Journal::GetErrorStr(void)
+{
+	return error;
+}
+
+bool
+Journal::Sync(void)
+{
+	if (!fp)
+		return true;
+	unsynced=0;
+	if (fflush(fp))
+		return true;
+#ifdef _WIN32
+	return _commit(_fileno(fp))!=0;
+#else
+	return fsync(fileno(fp))!=0;
+#endif
+}
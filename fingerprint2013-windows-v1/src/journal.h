@@ -0,0 +1,55 @@
+// Journal.h
+// Append-only result journal so an interrupted run can be resumed
+//
+// Copyright (C) 2008-2013, ir. R.L. Pijl
+
+#ifndef __JOURNAL_H
+#define __JOURNAL_H
+
+#include <stdio.h>
+#include "sha256.h"
+
+class Journal
+{
+public:
+	Journal();
+	virtual ~Journal();
+
+	// Reads the results of a previous run, if any, and opens the journal for
+	// appending. A journal of another suite, or of other engine settings when
+	// both digests are known (settings may be 0), is refused. Returns true on
+	// error.
+	bool Open(const char* name, int positions, unsigned long long suiteHash, const unsigned char* settings);
+	bool Close(void);
+
+	bool IsDone(int index);
+	int GetMove(int index);
+	int GetDoneCount(void);
+
+	// The ranked moves of a multipv search, if any. Returns their number.
+	enum { MAXTOP=8 };
+	int GetTopMoves(int index, int* moves, int size);
+
+	// Results are made durable in batches of SYNCINTERVAL entries
+	bool Append(int index, int move, const int* top=0, int topCount=0);
+	bool Sync(void);
+
+	const char* GetErrorStr(void);
+
+private:
+	FILE* fp;
+	int* moves;
+	int* top;
+	unsigned char* topCount;
+	bool* done;
+	int positions;
+	int doneCount;
+	int unsynced;
+	const char* error;
+
+	bool ParseLine(char* line);
+
+	enum { SYNCINTERVAL=64 };
+};
+
+#endif // __JOURNAL_H
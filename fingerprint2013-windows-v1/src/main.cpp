@@ -1,102 +1,597 @@
-// main.cpp
-// Fingerprinting tester for CSVN tournaments
-//
-// Copyright (C) 2013, ir. R.L. Pijl
-
-#include <stdio.h>
-#include <stdlib.h>
-#include <ctype.h>
-
-#include "engineuci.h"
-#include "enginewb.h"
-#include "util.h"
-
-volatile bool searching=false;
-FILE *fp;
-char buf[1024];
-
-bool fHandler(int move, int)
-{
-	fprintf(fp,"%s bm %s\n",buf,MoveStr(move));
-	searching=false;
-	return false;
-}
-
-
-int main(int argc, char* argv[])
-{
-	FILE *epd;
-
-	Engine* engine;
-
-	printf("CSVN Fingerprinting test tool v1.0\n");
-	printf("----------------------------------\n\n");
-	printf("What type of engine is used? (W/U) : ");
-	gets(buf);
-
-	if (toupper(*buf)=='U') {
-		engine=new UCIEngine;
-	} else {
-		engine=new WBEngine;
-	}
-
-	printf("What is the name of the engine executable? : ");
-	gets(buf);
-
-	if (engine->SetExecName(buf)) {
-		fprintf(stderr,"ERROR: %s\n",engine->GetErrorStr());
-		exit(1);
-	}
-	if (engine->SetWorkingDir(".")) {
-		fprintf(stderr,"ERROR: %s\n",engine->GetErrorStr());
-		exit(1);
-	}
-	if (engine->StartEngine()) {
-		fprintf(stderr,"ERROR: Could not start the engine: %s\n",engine->GetErrorStr());
-		exit(1);
-	} 
-
-	engine->Synchronize();
-	fprintf(stderr,"done.\n");
-
-	// Enter the option setting below here. This is only possible for UCI engines
-	// Both option name and value should be a string parameter
-	// Example:
-	// engine->SetOption("Threads","1");
-
-	epd=fopen("simcsvn1.dos.epd","r");
-	if (epd==0) {
-		printf("Could not open the epd-file simcsvn1.dos.epd\n");
-		exit(1);
-	}
-
-	fp=fopen("fingerprint.epd","w");
-	if (fp==0) {
-		printf("Could not open the epd-file fingerprint.epd\n");
-		exit(1);
-	}
-
-	int i=1;
-	while (fgets(buf,1024,epd)) {
-		strtok(buf,"\n\r");
-		engine->SetPosition(buf);
-		engine->SetSearchTime(1);
-		searching=true;
-		engine->Search(0, 0, fHandler, 0, 0, 0);
-		fprintf(stderr,"\rEngine search: %d/10000 ",i);
-		while (searching) {
-			fprintf(stderr,"\\\b"); Sleep(250);
-			if (!searching) break;
-			fprintf(stderr,"|\b"); Sleep(250);
-			if (!searching) break;
-			fprintf(stderr,"/\b"); Sleep(250);
-			if (!searching) break;
-			fprintf(stderr,"-\b"); Sleep(250);
-		}
-		i++;
-	}
-	fprintf(stderr,"\nDone.\n");
-	printf("The result can be found as 'fingerprint.epd'\n");
-	fclose(epd);
-	fclose(fp);
+// main.cpp
+// Fingerprinting tester for CSVN tournaments
+//
+// Copyright (C) 2013, ir. R.L. Pijl
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "agreement.h"
+#include "batch.h"
+#include "enginepool.h"
+#include "epd.h"
+#include "histogram.h"
+#include "journal.h"
+#include "position.h"
+#include "reactor.h"
+#include "resultcache.h"
+#include "suiteindex.h"
+#include "util.h"
+
+FILE *fp;
+char buf[1024];
+int positions=0;
+int* positionIndex;
+Journal* journal=0;
+SuiteIndex* suite=0;
+ResultCache* cache=0;
+uint64_t* positionKeys;
+int cacheHits=0;
+AgreementMonitor* monitor=0;
+// results kept to write the fingerprint in epd order at the end
+int* resultMoves=0;
+int* resultTop;
+unsigned char* resultTopCount;
+FILE* stats=0;
+bool profile=false;
+int multiPV=1;
+int isolation=Engine::isolateNone;
+Histogram firstInfoTime, finalTime, gapTime;
+volatile int finished=0;
+volatile bool progress=false;
+
+// the same random order of the positions in every run
+#define ORDERSEED 20130101
+
+static void readLine(char* line, int size)
+{
+	if (!fgets(line,size,stdin)) *line='\0';
+	line[strcspn(line,"\n\r")]='\0';
+}
+
+static void usage(void)
+{
+	printf("Usage: fingerprint [-cpus <n>] [-pipeline] [-movetime <ms> | -nodes <n> | -depth <n>]\n");
+	printf("                   [-journal <file>] [-epd <file>] [-stats <file>] [-profile]\n");
+	printf("                   [-multipv <k>] [-isolate none|newgame|clearhash] [-watchdog <ms>]\n");
+	printf("                   [-dedup] [-cache <file>] [-reference <fingerprint> ...]\n");
+	printf("                   [-threshold <pct>] [-batch <manifest>]\n\n");
+	printf("  -cpus <n>       number of engines searching in parallel (all single-threaded)\n");
+	printf("  -pipeline       queue the next position while the engine is still searching\n");
+	printf("  -movetime <ms>  search time per position in milliseconds (default 1000)\n");
+	printf("  -nodes <n>      search a fixed number of nodes per position\n");
+	printf("  -depth <n>      search to a fixed depth per position\n");
+	printf("  -journal <file> keep the results in a journal and resume from it on restart\n");
+	printf("  -epd <file>     positions to search (default simcsvn1.dos.epd)\n");
+	printf("  -stats <file>   write depth, score, nodes and time of every search as csv\n");
+	printf("  -profile        report latency histograms and the overhead of the tool\n");
+	printf("  -multipv <k>    also record the k best moves of every position (UCI only)\n");
+	printf("  -isolate <how>  reset the engine before every position: none (default),\n");
+	printf("                  newgame (ucinewgame) or clearhash (also Clear Hash, UCI only)\n");
+	printf("  -watchdog <ms>  restart an engine that did not finish a -nodes or -depth search\n");
+	printf("                  in this time (default none, -movetime searches get 1 s extra)\n");
+	printf("  -dedup          search positions that occur more than once, also with the colours\n");
+	printf("                  swapped, only once and copy the move to the others\n");
+	printf("  -cache <file>   reuse the results of earlier -nodes or -depth runs of the same\n");
+	printf("                  engine executable with the same settings\n");
+	printf("  -reference <fp> search the positions in a random order stratified by the number\n");
+	printf("                  of pieces and stop when the agreement with every reference\n");
+	printf("                  fingerprint is above or below the threshold with 99%% confidence\n");
+	printf("  -threshold <pct> agreement that decides similarity (default 60)\n");
+	printf("  -batch <file>   fingerprint every engine of the manifest to <name>.epd, sharing\n");
+	printf("                  the -cpus processors between engines with any number of threads\n");
+}
+
+static void writeFingerprint(const char* position, int length, int move, const int* top, int n)
+{
+	// in multipv mode the ranked moves follow as 'top' opcode, a position
+	// that was not searched (move<0) has no opcodes
+	if (move<0) {
+		fprintf(fp,"%.*s\n",length,position);
+		return;
+	}
+	fprintf(fp,"%.*s bm %s",length,position,MoveStr(move));
+	if (multiPV>1) {
+		fprintf(fp,"; top");
+		for (int i=0; i<n; i++)
+			fprintf(fp," %s",MoveStr(top[i]));
+		fprintf(fp,";");
+	}
+	fprintf(fp,"\n");
+}
+
+static void recordResult(int index, const char* epd, int move, const int* top, int n, bool failed)
+{
+	// a position the engine could not search has no best move, with a
+	// journal it is tried again on resume
+	if (failed) {
+		if (!journal && !resultMoves)
+			writeFingerprint(epd,(int)strlen(epd),-1,top,0);
+		return;
+	}
+	if (monitor)
+		monitor->Record(index,move);
+	if (journal) {
+		if (journal->Append(index,move,top,n))
+			fprintf(stderr,"\nERROR: Could not write to the journal\n");
+	} else if (resultMoves) {
+		resultMoves[index]=move;
+		memcpy(&resultTop[index*Engine::MAXMULTIPV],top,n*sizeof(int));
+		resultTopCount[index]=n;
+	} else
+		writeFingerprint(epd,(int)strlen(epd),move,top,n);
+}
+
+static bool skipPosition(int index)
+{
+	// with -dedup only the first position of a group is searched, as long
+	// as any position of the group is not in the journal yet
+	if (suite) {
+		if (suite->GetFirst(index)!=index)
+			return true;
+		for (int i=index; i>=0; i=suite->GetNext(i))
+			if (!journal || !journal->IsDone(i))
+				return false;
+		return true;
+	}
+	return journal && journal->IsDone(index);
+}
+
+static void deliverResult(int index, const char* epd, int move, const int* topMoves, int n, bool failed=false)
+{
+	if (suite) {
+		for (int i=index; i>=0; i=suite->GetNext(i)) {
+			bool mirrored=suite->IsMirrored(i);
+			int top[Engine::MAXMULTIPV];
+
+			if (journal && journal->IsDone(i))
+				continue;
+			for (int k=0; k<n; k++)
+				top[k]=mirrored ? Position::MirrorMove(topMoves[k]) : topMoves[k];
+			recordResult(i,0,mirrored ? Position::MirrorMove(move) : move,top,n,failed);
+			finished++;
+		}
+	} else {
+		recordResult(index,epd,move,topMoves,n,failed);
+		finished++;
+	}
+}
+
+static bool cachedResult(int index, const epdLine_t* line)
+{
+	// positions the tool cannot decode are always searched
+	Position position;
+	char fen[256];
+	int move, top[ResultCache::MAXTOP], n;
+
+	snprintf(fen,sizeof(fen),"%.*s",line->position.length,line->position.ptr);
+	positionKeys[index]=position.SetFEN(fen) ? 0 : position.Key();
+	if (!positionKeys[index] || !cache->Lookup(positionKeys[index],&move,top,&n))
+		return false;
+	deliverResult(index,0,move,top,n);
+	cacheHits++;
+	return true;
+}
+
+bool rHandler(const EnginePool::result_t* result, void*)
+{
+	int index=positionIndex[result->id];
+
+	deliverResult(index,result->epd,result->bestMove,result->topMoves,result->topCount,result->failed);
+	if (cache && !result->failed && positionKeys[index]
+		&& cache->Append(positionKeys[index],result->bestMove,result->topMoves,result->topCount))
+		fprintf(stderr,"\nERROR: Could not write to the cache\n");
+	if (profile) {
+		firstInfoTime.Record(result->stats.firstInfoUs);
+		finalTime.Record(result->stats.finalUs);
+		gapTime.Record(result->stats.gapUs);
+	}
+	if (stats) {
+		const Engine::searchStats_t* s=&result->stats;
+		int time=s->time>0 ? s->time : s->elapsed;
+
+		fprintf(stats,"%d,%s,%d,%d,%d,%lld,%d,%lld,%d\n",positionIndex[result->id],
+			MoveStr(result->bestMove),s->depth,s->seldepth,s->score,s->nodes,s->time,
+			s->nodes>=0 && time>0 ? s->nodes*1000/time : -1LL,s->elapsed);
+	}
+	return false;
+}
+
+void progressTimer(void*)
+{
+	// the progress display runs on its own timer, searches never wait for it
+	static const char spinner[]="\\|/-";
+	static int phase=0;
+
+	if (!progress) return;
+	fprintf(stderr,"\rEngine search: %d/%d %c\b",finished,positions,spinner[phase++&3]);
+	Reactor::Get()->AddTimer(250,progressTimer,0);
+}
+
+
+static void printProfile(unsigned long long runTime, int cpus)
+{
+	// the engines were busy from sending a search until its final response,
+	// all other time of the run is spent waiting for the tool
+	double capacity=(double)runTime*cpus;
+	double busy=capacity>0 ? 100.0*finalTime.GetTotal()/capacity : 0.0;
+
+	fprintf(stderr,"\n");
+	firstInfoTime.Print(stderr,"Search sent until first info:",1000.0,"Value (ms)");
+	fprintf(stderr,"\n");
+	finalTime.Print(stderr,"Search sent until best move:",1000.0,"Value (ms)");
+	fprintf(stderr,"\n");
+	gapTime.Print(stderr,"Best move until next search sent (same engine):",1000.0,"Value (ms)");
+	fprintf(stderr,"\nProfile: %lld positions in %.1f s on %d engine(s), engines busy %.1f%%, "
+		"gap mean %.3f ms p99 %.3f ms, first info p50 %.3f ms, best move p50 %.3f ms\n",
+		finalTime.GetCount(),runTime/1e6,cpus,busy,gapTime.GetMean()/1000.0,
+		gapTime.ValueAtPercentile(99.0)/1000.0,firstInfoTime.ValueAtPercentile(50.0)/1000.0,
+		finalTime.ValueAtPercentile(50.0)/1000.0);
+}
+
+int main(int argc, char* argv[])
+{
+	EpdReader epd;
+	epdLine_t line;
+	const char* epdName="simcsvn1.dos.epd";
+	const char* statsName=0;
+	EnginePool pool;
+	int type;
+	int cpus=1;
+	bool pipelined=false;
+	int movetime=1000;
+	long long nodes=0;
+	int depth=0;
+	const char* journalName=0;
+	int watchdog=0;
+	bool dedup=false;
+	const char* cacheName=0;
+	const char** referenceNames=new const char*[argc];
+	int references=0;
+	double threshold=60.0;
+	const char* batchName=0;
+
+	for (int a=1; a<argc; a++) {
+		if (strcmp(argv[a],"-cpus")==0 && a+1<argc) {
+			cpus=atoi(argv[++a]);
+			continue;
+		}
+		if (strcmp(argv[a],"-pipeline")==0) {
+			pipelined=true;
+			continue;
+		}
+		if (strcmp(argv[a],"-movetime")==0 && a+1<argc) {
+			movetime=atoi(argv[++a]);
+			continue;
+		}
+		if (strcmp(argv[a],"-nodes")==0 && a+1<argc) {
+			nodes=atoll(argv[++a]);
+			continue;
+		}
+		if (strcmp(argv[a],"-depth")==0 && a+1<argc) {
+			depth=atoi(argv[++a]);
+			continue;
+		}
+		if (strcmp(argv[a],"-journal")==0 && a+1<argc) {
+			journalName=argv[++a];
+			continue;
+		}
+		if (strcmp(argv[a],"-epd")==0 && a+1<argc) {
+			epdName=argv[++a];
+			continue;
+		}
+		if (strcmp(argv[a],"-stats")==0 && a+1<argc) {
+			statsName=argv[++a];
+			continue;
+		}
+		if (strcmp(argv[a],"-profile")==0) {
+			profile=true;
+			continue;
+		}
+		if (strcmp(argv[a],"-multipv")==0 && a+1<argc) {
+			multiPV=atoi(argv[++a]);
+			continue;
+		}
+		if (strcmp(argv[a],"-watchdog")==0 && a+1<argc) {
+			watchdog=atoi(argv[++a]);
+			continue;
+		}
+		if (strcmp(argv[a],"-cache")==0 && a+1<argc) {
+			cacheName=argv[++a];
+			continue;
+		}
+		if (strcmp(argv[a],"-reference")==0 && a+1<argc) {
+			referenceNames[references++]=argv[++a];
+			continue;
+		}
+		if (strcmp(argv[a],"-threshold")==0 && a+1<argc) {
+			threshold=atof(argv[++a]);
+			continue;
+		}
+		if (strcmp(argv[a],"-batch")==0 && a+1<argc) {
+			batchName=argv[++a];
+			continue;
+		}
+		if (strcmp(argv[a],"-dedup")==0) {
+			dedup=true;
+			continue;
+		}
+		if (strcmp(argv[a],"-isolate")==0 && a+1<argc) {
+			a++;
+			if (strcmp(argv[a],"none")==0)
+				isolation=Engine::isolateNone;
+			else if (strcmp(argv[a],"newgame")==0)
+				isolation=Engine::isolateNewGame;
+			else if (strcmp(argv[a],"clearhash")==0)
+				isolation=Engine::isolateClearHash;
+			else {
+				usage();
+				exit(1);
+			}
+			continue;
+		}
+		usage();
+		exit(1);
+	}
+
+	printf("CSVN Fingerprinting test tool v1.0\n");
+	printf("----------------------------------\n\n");
+
+	if (batchName) {
+		// the engines come from the manifest instead of the questions below
+		Batch batch;
+		batchSettings_t settings;
+
+		settings.cores=cpus;
+		settings.pipelined=pipelined;
+		settings.movetime=movetime;
+		settings.nodes=nodes;
+		settings.depth=depth;
+		settings.multiPV=multiPV;
+		settings.isolation=isolation;
+		settings.watchdog=watchdog;
+		if (batch.Load(batchName)) {
+			printf("Could not load the batch: %s\n",batch.GetErrorStr());
+			exit(1);
+		}
+		if (batch.Run(epdName,&settings)) {
+			printf("%s\n",batch.GetErrorStr());
+			exit(1);
+		}
+		exit(0);
+	}
+
+	printf("What type of engine is used? (W/U) : ");
+	readLine(buf,sizeof(buf));
+
+	if (toupper(*buf)=='U') {
+		type=EnginePool::poolUCI;
+	} else {
+		type=EnginePool::poolWB;
+	}
+
+	printf("What is the name of the engine executable? : ");
+	readLine(buf,sizeof(buf));
+
+	if (pool.StartEngines(type,buf,".",cpus)) {
+		fprintf(stderr,"ERROR: Could not start the engine: %s\n",pool.GetErrorStr());
+		exit(1);
+	} 
+
+	pool.Synchronize();
+	fprintf(stderr,"done.\n");
+
+	// Enter the option setting below here. This is only possible for UCI engines
+	// Both option name and value should be a string parameter
+	// Example:
+	// pool.SetOption("Threads","1");
+
+	// DOS and Unix line endings are both accepted
+	if (epd.Open(epdName)) {
+		printf("Could not open the epd-file %s\n",epdName);
+		exit(1);
+	}
+
+	fp=fopen("fingerprint.epd","w");
+	if (fp==0) {
+		printf("Could not open the epd-file fingerprint.epd\n");
+		exit(1);
+	}
+
+	if (statsName) {
+		stats=fopen(statsName,"w");
+		if (stats==0) {
+			printf("Could not open the statistics file %s\n",statsName);
+			exit(1);
+		}
+		fprintf(stats,"position,bm,depth,seldepth,score,nodes,time,nps,elapsed\n");
+	}
+
+	positions=epd.Count();
+	positionIndex=new int[positions];
+
+	unsigned long long suiteHash=SUITEHASHINIT;
+
+	if (references || journalName) {
+		while (epd.Next(&line))
+			suiteHash=SuiteHashLine(suiteHash,line.position.ptr,line.position.length);
+		epd.Rewind();
+	}
+
+	if (references) {
+		monitor=new AgreementMonitor;
+		for (int r=0; r<references; r++) {
+			if (monitor->AddReference(referenceNames[r])) {
+				printf("Could not load the reference %s: %s\n",referenceNames[r],monitor->GetErrorStr());
+				exit(1);
+			}
+		}
+		if (monitor->GetPositions()!=positions || monitor->GetSuiteHash()!=suiteHash) {
+			printf("The reference fingerprints are not of the positions in %s\n",epdName);
+			exit(1);
+		}
+		monitor->SetThreshold(threshold/100.0);
+	}
+
+	if (dedup) {
+		suite=new SuiteIndex;
+		if (suite->Build(&epd)) {
+			printf("Could not index the positions of %s\n",epdName);
+			exit(1);
+		}
+		fprintf(stderr,"%d distinct positions, %d duplicates and mirrors are not searched.\n",
+			suite->GetDistinctCount(),positions-suite->GetDistinctCount());
+	}
+
+	pool.SetResultHandler(rHandler);
+	pool.SetPipelined(pipelined);
+	if (nodes>0 ? pool.SetSearchNodes(nodes) : depth>0 ? pool.SetSearchDepth(depth) : pool.SetSearchTimeMs(movetime)) {
+		fprintf(stderr,"ERROR: Could not set the search limit: %s\n",pool.GetErrorStr());
+		exit(1);
+	}
+	if (pool.SetMultiPV(multiPV)) {
+		fprintf(stderr,"ERROR: Could not search %d principal variations: %s\n",multiPV,pool.GetErrorStr());
+		exit(1);
+	}
+	if (pool.SetIsolation(isolation)) {
+		fprintf(stderr,"ERROR: Could not isolate the positions: %s\n",pool.GetErrorStr());
+		exit(1);
+	}
+	pool.SetWatchdog(watchdog);
+
+	// what identifies the results besides the positions
+	unsigned char settings[Sha256::DIGESTSIZE];
+	bool noSettings=(journalName || cacheName) && pool.GetSettingsDigest(settings);
+
+	if (journalName) {
+		journal=new Journal;
+		if (journal->Open(journalName,positions,suiteHash,noSettings ? 0 : settings)) {
+			printf("Could not open the journal %s: %s\n",journalName,journal->GetErrorStr());
+			exit(1);
+		}
+		finished=journal->GetDoneCount();
+		if (finished)
+			fprintf(stderr,"Resuming, %d positions done already.\n",finished);
+		for (int i=0; monitor && i<positions; i++)
+			if (journal->IsDone(i))
+				monitor->Record(i,journal->GetMove(i));
+	}
+
+	if (cacheName) {
+		// timed searches do not give the same result twice
+		if (nodes<=0 && depth<=0) {
+			printf("The cache can only be used with -nodes or -depth\n");
+			exit(1);
+		}
+		if (noSettings) {
+			printf("Could not read the engine executable to identify it for the cache\n");
+			exit(1);
+		}
+		cache=new ResultCache;
+		if (cache->Open(cacheName,settings)) {
+			printf("Could not open the cache %s\n",cacheName);
+			exit(1);
+		}
+		positionKeys=new uint64_t[positions];
+	}
+	if (suite || cache || monitor) {
+		resultMoves=new int[positions];
+		memset(resultMoves,-1,positions*sizeof(int));
+		resultTop=new int[positions*Engine::MAXMULTIPV];
+		resultTopCount=new unsigned char[positions];
+	}
+	progress=true;
+	progressTimer(0);
+	unsigned long long runStart=TimeUs();
+	epdLine_t* lines=0;
+	int* order=0;
+	if (monitor) {
+		// the strata are the numbers of pieces on the board
+		int* strata=new int[positions];
+
+		lines=new epdLine_t[positions];
+		order=new int[positions];
+		for (int k=0; k<positions && epd.Next(&lines[k]); k++) {
+			Position position;
+			char fen[256];
+
+			snprintf(fen,sizeof(fen),"%.*s",lines[k].position.length,lines[k].position.ptr);
+			strata[k]=position.SetFEN(fen) ? 0 : position.GetPieceCount();
+		}
+		StratifiedOrder(strata,positions,ORDERSEED,order);
+		delete[] strata;
+	}
+	int i, n=0;
+	for (int k=0; k<positions; k++) {
+		if (monitor) {
+			if (monitor->IsDecided())
+				break;
+			i=order[k];
+			line=lines[i];
+		} else if (!epd.Next(&line))
+			break;
+		else
+			i=k;
+		if (skipPosition(i) || (cache && cachedResult(i,&line)))
+			continue;
+		positionIndex[n++]=i;
+		if (pool.Analyse(line.position.ptr,line.position.length))
+			fprintf(stderr,"\nERROR: %s\n",pool.GetErrorStr());
+	}
+	pool.WaitForAll();
+	unsigned long long runTime=TimeUs()-runStart;
+	progress=false;
+	pool.Stop();
+
+	if (journal) {
+		// the journal is complete, write the fingerprint in epd order
+		journal->Close();
+		epd.Rewind();
+		for (i=0; epd.Next(&line); i++) {
+			int top[Journal::MAXTOP];
+			int n=journal->GetTopMoves(i,top,Journal::MAXTOP);
+
+			writeFingerprint(line.position.ptr,line.position.length,
+				journal->IsDone(i) ? journal->GetMove(i) : -1,top,n);
+		}
+		delete journal;
+	} else if (resultMoves) {
+		epd.Rewind();
+		for (i=0; epd.Next(&line); i++)
+			writeFingerprint(line.position.ptr,line.position.length,resultMoves[i],
+				&resultTop[i*Engine::MAXMULTIPV],resultTopCount[i]);
+	}
+	delete suite;
+	if (cache) {
+		if (cache->Close())
+			fprintf(stderr,"ERROR: Could not write to the cache\n");
+		delete cache;
+	}
+	fprintf(stderr,"\rEngine search: %d/%d \nDone.\n",finished,positions);
+	if (pool.GetIllegalMoves())
+		fprintf(stderr,"WARNING: %d best moves were not legal and were written as a1a1\n",pool.GetIllegalMoves());
+	if (pool.GetFailedPositions())
+		fprintf(stderr,"WARNING: the engine could not search %d positions, they have no best move\n",
+			pool.GetFailedPositions());
+	if (cacheHits)
+		fprintf(stderr,"%d positions were taken from the cache.\n",cacheHits);
+	if (monitor) {
+		if (finished<positions)
+			fprintf(stderr,"Stopped after %d of %d positions, the positions that were not searched have no best move.\n",
+				finished,positions);
+		monitor->Print(stdout);
+		delete monitor;
+		delete[] lines;
+		delete[] order;
+	}
+	printf("The result can be found as 'fingerprint.epd'\n");
+	if (profile)
+		printProfile(runTime,cpus);
+	epd.Close();
+	fclose(fp);
+	if (stats)
+		fclose(stats);
+	return pool.GetFailedPositions() ? 1 : 0;
 }
\ No newline at end of file
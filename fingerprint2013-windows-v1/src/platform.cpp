@@ -0,0 +1,386 @@
+// Platform.cpp
+//
+// Copyright (C) 2008-2013, ir. R.L. Pijl
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#ifndef _WIN32
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sched.h>
+#include <dirent.h>
+#endif
+#endif
+#include "platform.h"
+
+typedef struct {
+	threadFunction func;
+	void* param;
+} threadStart_t;
+
+#ifdef _WIN32
+
+static DWORD WINAPI threadEntry(LPVOID lpParam)
+{
+	threadStart_t start=*(threadStart_t*)lpParam;
+
+	delete (threadStart_t*)lpParam;
+	return (DWORD)start.func(start.param);
+}
+
+bool StartThread(threadFunction func, void* param)
+{
+	DWORD dwThreadId;
+	HANDLE hThread;
+	threadStart_t* start=new threadStart_t;
+
+	start->func=func;
+	start->param=param;
+	hThread=CreateThread(NULL, 0, threadEntry, start, 0, &dwThreadId);
+	if (hThread==0) {
+		delete start;
+		return true;
+	}
+	// thread runs detached, the handle is not needed anymore
+	CloseHandle(hThread);
+	return false;
+}
+
+bool SetProcessAffinity(intptr_t process, const int* cores, int n)
+{
+	DWORD_PTR mask=0;
+
+	for (int i=0; i<n; i++)
+		if (cores[i]>=0 && cores[i]<(int)(8*sizeof(mask)))
+			mask|=(DWORD_PTR)1<<cores[i];
+	return mask==0 || !SetProcessAffinityMask((HANDLE)process,mask);
+}
+
+unsigned long long TimeMs(void)
+{
+	return GetTickCount64();
+}
+
+unsigned long long TimeUs(void)
+{
+	static LARGE_INTEGER frequency;
+	LARGE_INTEGER now;
+
+	if (frequency.QuadPart==0)
+		QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&now);
+	return (unsigned long long)(now.QuadPart/frequency.QuadPart)*1000000
+		+(unsigned long long)(now.QuadPart%frequency.QuadPart)*1000000/frequency.QuadPart;
+}
+
+#else
+
+static void* threadEntry(void* lpParam)
+{
+	threadStart_t start=*(threadStart_t*)lpParam;
+
+	delete (threadStart_t*)lpParam;
+	start.func(start.param);
+	return 0;
+}
+
+bool StartThread(threadFunction func, void* param)
+{
+	pthread_t thread;
+	threadStart_t* start=new threadStart_t;
+
+	start->func=func;
+	start->param=param;
+	if (pthread_create(&thread, 0, threadEntry, start)) {
+		delete start;
+		return true;
+	}
+	pthread_detach(thread);
+	return false;
+}
+
+bool SetProcessAffinity(intptr_t process, const int* cores, int n)
+{
+#ifdef __linux__
+	// The affinity of a pid is that of a single thread. Every thread of the
+	// process is restricted, again until no new ones show up, as a thread
+	// started before its creator was restricted has the full mask.
+	cpu_set_t set;
+	char path[64];
+	int threads=0, last=-1;
+
+	CPU_ZERO(&set);
+	for (int i=0; i<n; i++)
+		if (cores[i]>=0 && cores[i]<CPU_SETSIZE)
+			CPU_SET(cores[i],&set);
+	if (CPU_COUNT(&set)==0 || sched_setaffinity((pid_t)process,sizeof(set),&set)!=0)
+		return true;
+	snprintf(path,sizeof(path),"/proc/%d/task",(int)process);
+	for (int pass=0; pass<10 && threads!=last; pass++) {
+		DIR* dir=opendir(path);
+		struct dirent* entry;
+
+		if (!dir)
+			break;
+		last=threads;
+		threads=0;
+		while ((entry=readdir(dir))) {
+			if (*entry->d_name<'0' || *entry->d_name>'9')
+				continue;
+			sched_setaffinity((pid_t)atoi(entry->d_name),sizeof(set),&set);
+			threads++;
+		}
+		closedir(dir);
+	}
+	return false;
+#else
+	// Mac OS X has no processor affinity, the scheduler decides
+	return false;
+#endif
+}
+
+void Sleep(unsigned int milliseconds)
+{
+	usleep(milliseconds*1000);
+}
+
+unsigned long long TimeMs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec*1000+ts.tv_nsec/1000000;
+}
+
+unsigned long long TimeUs(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long)ts.tv_sec*1000000+ts.tv_nsec/1000;
+}
+
+#endif
+
+#ifdef _WIN32
+
+Mutex::Mutex() { InitializeCriticalSection(&cs); }
+Mutex::~Mutex() { DeleteCriticalSection(&cs); }
+void Mutex::Lock(void) { EnterCriticalSection(&cs); }
+void Mutex::Unlock(void) { LeaveCriticalSection(&cs); }
+
+Condition::Condition() { InitializeConditionVariable(&cv); }
+Condition::~Condition() { }
+void Condition::Wait(Mutex& mutex) { SleepConditionVariableCS(&cv, &mutex.cs, INFINITE); }
+bool Condition::Wait(Mutex& mutex, int milliseconds)
+{
+	return !SleepConditionVariableCS(&cv, &mutex.cs, milliseconds) && GetLastError()==ERROR_TIMEOUT;
+}
+void Condition::Signal(void) { WakeConditionVariable(&cv); }
+void Condition::Broadcast(void) { WakeAllConditionVariable(&cv); }
+
+#else
+
+Mutex::Mutex() { pthread_mutex_init(&mutex, 0); }
+Mutex::~Mutex() { pthread_mutex_destroy(&mutex); }
+void Mutex::Lock(void) { pthread_mutex_lock(&mutex); }
+void Mutex::Unlock(void) { pthread_mutex_unlock(&mutex); }
+
+// The timed wait uses the monotonic clock where the condition can be told
+// so, a wall clock that is set does not move its timeout then. macOS has
+// no pthread_condattr_setclock and keeps the realtime clock.
+#ifdef __APPLE__
+#define CONDITIONCLOCK CLOCK_REALTIME
+Condition::Condition() { pthread_cond_init(&cond, 0); }
+#else
+#define CONDITIONCLOCK CLOCK_MONOTONIC
+Condition::Condition()
+{
+	pthread_condattr_t attr;
+
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(&cond, &attr);
+	pthread_condattr_destroy(&attr);
+}
+#endif
+Condition::~Condition() { pthread_cond_destroy(&cond); }
+void Condition::Wait(Mutex& mutex) { pthread_cond_wait(&cond, &mutex.mutex); }
+bool Condition::Wait(Mutex& mutex, int milliseconds)
+{
+	// the timeout is absolute, on the clock of the condition
+	struct timespec ts;
+
+	clock_gettime(CONDITIONCLOCK, &ts);
+	ts.tv_sec+=milliseconds/1000;
+	ts.tv_nsec+=(milliseconds%1000)*1000000L;
+	if (ts.tv_nsec>=1000000000L) {
+		ts.tv_sec++;
+		ts.tv_nsec-=1000000000L;
+	}
+	return pthread_cond_timedwait(&cond, &mutex.mutex, &ts)==ETIMEDOUT;
+}
+void Condition::Signal(void) { pthread_cond_signal(&cond); }
+void Condition::Broadcast(void) { pthread_cond_broadcast(&cond); }
+
+#endif
+
+MappedFile::MappedFile()
+{
+	data=0;
+	size=0;
+#ifdef _WIN32
+	file=INVALID_HANDLE_VALUE;
+	mapping=0;
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::Open(const char* name)
+{
+	LARGE_INTEGER length;
+
+	Close();
+	file=CreateFileA(name, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file==INVALID_HANDLE_VALUE)
+		return true;
+	if (!GetFileSizeEx(file, &length)) {
+		Close();
+		return true;
+	}
+	size=(size_t)length.QuadPart;
+	// an empty file can not be mapped, but is a valid (empty) result
+	if (size==0)
+		return false;
+	mapping=CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (mapping)
+		data=MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!data) {
+		Close();
+		return true;
+	}
+	return false;
+}
+
+void MappedFile::Close(void)
+{
+	if (data)
+		UnmapViewOfFile(data);
+	if (mapping)
+		CloseHandle(mapping);
+	if (file!=INVALID_HANDLE_VALUE)
+		CloseHandle(file);
+	data=0;
+	size=0;
+	mapping=0;
+	file=INVALID_HANDLE_VALUE;
+}
+
+#else
+
+bool MappedFile::Open(const char* name)
+{
+	struct stat st;
+	int fd;
+
+	Close();
+	fd=open(name, O_RDONLY);
+	if (fd<0)
+		return true;
+	if (fstat(fd, &st)) {
+		close(fd);
+		return true;
+	}
+	size=(size_t)st.st_size;
+	if (size>0) {
+		void* p=mmap(0, size, PROT_READ, MAP_SHARED, fd, 0);
+
+		if (p==MAP_FAILED) {
+			close(fd);
+			size=0;
+			return true;
+		}
+		data=p;
+	}
+	// the mapping stays valid after the descriptor is closed
+	close(fd);
+	return false;
+}
+
+void MappedFile::Close(void)
+{
+	if (data)
+		munmap((void*)data, size);
+	data=0;
+	size=0;
+}
+
+#endif
+
+const void* MappedFile::GetData(void)
+{
+	return data;
+}
+
+size_t MappedFile::GetSize(void)
+{
+	return size;
+}
+
+char* FindExecutable(const char* name)
+{
+	char* path;
+	size_t n=strlen(name);
+#ifdef _WIN32
+	// _spawnv tries the name as it is, then with .exe
+	FILE* fp=fopen(name,"rb");
+
+	if (fp) {
+		fclose(fp);
+		return strdup(name);
+	}
+	path=(char*)malloc(n+5);
+	snprintf(path,n+5,"%s.exe",name);
+	fp=fopen(path,"rb");
+	if (fp) {
+		fclose(fp);
+		return path;
+	}
+	free(path);
+	return 0;
+#else
+	// as StartProcess: posix_spawn first, then posix_spawnp
+	const char* dirs=getenv("PATH");
+
+	if (access(name,X_OK)==0)
+		return strdup(name);
+	if (strchr(name,'/'))
+		return 0;
+	for (const char* dir=dirs; dir; dir=strchr(dir,':') ? strchr(dir,':')+1 : 0) {
+		size_t length=strcspn(dir,":");
+
+		// an empty entry is the working directory
+		path=(char*)malloc(length+n+3);
+		if (length)
+			snprintf(path,length+n+3,"%.*s/%s",(int)length,dir,name);
+		else
+			snprintf(path,length+n+3,"./%s",name);
+		if (access(path,X_OK)==0)
+			return path;
+		free(path);
+	}
+	return 0;
+#endif
+}
@@ -0,0 +1,106 @@
+// Platform.h
+// Operating system abstraction: threads, synchronisation, timing and files
+//
+// Copyright (C) 2008-2013, ir. R.L. Pijl
+
+#ifndef __PLATFORM_H
+#define __PLATFORM_H
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef _WIN32
+// Windows compatible sleep in milliseconds
+void Sleep(unsigned int milliseconds);
+#endif
+
+typedef int (*threadFunction)(void* param);
+
+// Start a detached thread running func(param). Returns true on error.
+bool StartThread(threadFunction func, void* param);
+
+// Restrict a child process, a handle on Windows and a pid elsewhere, to the
+// given processors, all its threads included. It does nothing on systems
+// without processor affinity. Returns true on error.
+bool SetProcessAffinity(intptr_t process, const int* cores, int n);
+
+// The file an engine started as name runs: on Windows name or name.exe,
+// elsewhere name relative to the working directory, then through the PATH
+// when it has no slash. Returns a copy to be freed, 0 when there is none.
+char* FindExecutable(const char* name);
+
+// Monotonic clock in milliseconds
+unsigned long long TimeMs(void);
+// Monotonic clock in microseconds, for measurements
+unsigned long long TimeUs(void);
+
+class Mutex
+{
+public:
+	Mutex();
+	~Mutex();
+
+	void Lock(void);
+	void Unlock(void);
+
+	friend class Condition;
+
+private:
+#ifdef _WIN32
+	CRITICAL_SECTION cs;
+#else
+	pthread_mutex_t mutex;
+#endif
+};
+
+class Condition
+{
+public:
+	Condition();
+	~Condition();
+
+	// Mutex must be locked by the caller. The timed wait returns true when
+	// the time has passed without a signal.
+	void Wait(Mutex& mutex);
+	bool Wait(Mutex& mutex, int milliseconds);
+	void Signal(void);
+	void Broadcast(void);
+
+private:
+#ifdef _WIN32
+	CONDITION_VARIABLE cv;
+#else
+	pthread_cond_t cond;
+#endif
+};
+
+// Read-only memory mapping of a complete file
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+
+	// Returns true on error
+	bool Open(const char* name);
+	void Close(void);
+
+	const void* GetData(void);
+	size_t GetSize(void);
+
+private:
+	const void* data;
+	size_t size;
+#ifdef _WIN32
+	HANDLE file;
+	HANDLE mapping;
+#endif
+};
+
+#endif // __PLATFORM_H
@@ -0,0 +1,628 @@
+// Position.cpp
+//
+// Copyright (C) 2008-2013, ir. R.L. Pijl
+
+#include <string.h>
+#include <ctype.h>
+#include "position.h"
+
+#define BIT(sq) ((uint64_t)1 << (sq))
+
+// Directions 0-3 run towards higher squares, 4-7 towards lower ones. The
+// rook uses the even directions, the bishop the odd ones.
+static const int dirs[8][2]={ {1,0}, {1,1}, {0,1}, {-1,1}, {-1,0}, {-1,-1}, {0,-1}, {1,-1} };
+
+static uint64_t knightAttacks[64];
+static uint64_t kingAttacks[64];
+static uint64_t rays[8][64];
+static uint64_t zobristPieces[2][6][64];
+static uint64_t zobristCastling[16];
+static uint64_t zobristEp[8];
+static uint64_t zobristSide;
+
+static const char promoChar[]="\0qrbn";
+static const int promoPiece[5]={ Position::nopiece, Position::queen, Position::rook, Position::bishop, Position::knight };
+
+// FEN characters: 0-11 pieces (white pawn .. black king), FENSLASH for a
+// new rank, FENSLASH+n for n empty squares and FENBAD for anything else
+enum { FENBAD=12, FENSLASH=13 };
+static unsigned char fenCodes[256];
+
+static void initFenCodes(void)
+{
+	static const char pieceChars[]="PNBRQKpnbrqk";
+
+	memset(fenCodes,FENBAD,sizeof(fenCodes));
+	for (int i=0; i<12; i++)
+		fenCodes[(unsigned char)pieceChars[i]]=i;
+	fenCodes[(unsigned char)'/']=FENSLASH;
+	for (int n=1; n<=8; n++)
+		fenCodes['0'+n]=FENSLASH+n;
+}
+
+static uint64_t nextRandom(uint64_t* state)
+{
+	// splitmix64, the keys must be the same in every run and on every platform
+	uint64_t z=(*state+=0x9E3779B97F4A7C15ULL);
+
+	z=(z ^ (z>>30))*0xBF58476D1CE4E5B9ULL;
+	z=(z ^ (z>>27))*0x94D049BB133111EBULL;
+	return z ^ (z>>31);
+}
+
+static void initZobrist(void)
+{
+	uint64_t state=0x46696E6765727072ULL;
+
+	for (int c=0; c<2; c++)
+		for (int p=0; p<6; p++)
+			for (int sq=0; sq<64; sq++)
+				zobristPieces[c][p][sq]=nextRandom(&state);
+	zobristCastling[0]=0;
+	for (int i=1; i<16; i++)
+		zobristCastling[i]=nextRandom(&state);
+	for (int f=0; f<8; f++)
+		zobristEp[f]=nextRandom(&state);
+	zobristSide=nextRandom(&state);
+}
+
+static void initTables(void)
+{
+	static const int jumps[8][2]={ {1,2}, {2,1}, {2,-1}, {1,-2}, {-1,-2}, {-2,-1}, {-2,1}, {-1,2} };
+
+	for (int sq=0; sq<64; sq++) {
+		int f=sq&7, r=sq>>3;
+
+		knightAttacks[sq]=kingAttacks[sq]=0;
+		for (int i=0; i<8; i++) {
+			int jf=f+jumps[i][0], jr=r+jumps[i][1];
+			int sf=f+dirs[i][0], sr=r+dirs[i][1];
+
+			if (jf>=0 && jf<8 && jr>=0 && jr<8)
+				knightAttacks[sq]|=BIT(jf+8*jr);
+			if (sf>=0 && sf<8 && sr>=0 && sr<8)
+				kingAttacks[sq]|=BIT(sf+8*sr);
+			rays[i][sq]=0;
+			while (sf>=0 && sf<8 && sr>=0 && sr<8) {
+				rays[i][sq]|=BIT(sf+8*sr);
+				sf+=dirs[i][0];
+				sr+=dirs[i][1];
+			}
+		}
+	}
+	initFenCodes();
+	initZobrist();
+}
+
+// The tables are built during static initialisation, before main starts
+// any thread. Positions are made on the reactor and pool threads at once.
+static struct tablesInit_s {
+	tablesInit_s() { initTables(); }
+} tablesInit;
+
+static int lowestBit(uint64_t b)
+{
+#if defined(__GNUC__)
+	return __builtin_ctzll(b);
+#else
+	int sq=0;
+
+	while (!(b & 1)) {
+		b>>=1;
+		sq++;
+	}
+	return sq;
+#endif
+}
+
+static int highestBit(uint64_t b)
+{
+#if defined(__GNUC__)
+	return 63-__builtin_clzll(b);
+#else
+	int sq=63;
+
+	while (!(b & BIT(63))) {
+		b<<=1;
+		sq--;
+	}
+	return sq;
+#endif
+}
+
+static uint64_t slide(int sq, int first, uint64_t occupied)
+{
+	// squares reached along every other ray from first, up to and
+	// including the first piece on it
+	uint64_t attacks=0;
+
+	for (int d=first; d<8; d+=2) {
+		uint64_t ray=rays[d][sq];
+		uint64_t blockers=ray & occupied;
+
+		if (blockers)
+			ray^=rays[d][d<4 ? lowestBit(blockers) : highestBit(blockers)];
+		attacks|=ray;
+	}
+	return attacks;
+}
+
+static uint64_t flipRanks(uint64_t b)
+{
+#if defined(__GNUC__)
+	return __builtin_bswap64(b);
+#else
+	uint64_t flipped=0;
+
+	for (int r=0; r<8; r++, b>>=8)
+		flipped=(flipped<<8) | (b & 0xFF);
+	return flipped;
+#endif
+}
+
+#define ROOKATTACKS(sq,occ) slide(sq,0,occ)
+#define BISHOPATTACKS(sq,occ) slide(sq,1,occ)
+
+Position::Position()
+{
+	memset(pieces,0,sizeof(pieces));
+	occupied[0]=occupied[1]=0;
+	side=0;
+	castling=0;
+	epSquare=-1;
+	whiteKing=blackKing=-1;
+}
+
+bool
+Position::SetFEN(const char* fen)
+{
+	int rank=7, file=0;
+	const char* p=fen;
+
+	memset(pieces,0,sizeof(pieces));
+	occupied[0]=occupied[1]=0;
+	castling=0;
+	epSquare=-1;
+
+	for (; *p && *p!=' '; p++) {
+		int code=fenCodes[(unsigned char)*p];
+
+		if (code<12) {
+			// a piece, white ones first
+			if (file>7)
+				return true;
+			pieces[code>=6][code%6]|=BIT(file+8*rank);
+			occupied[code>=6]|=BIT(file+8*rank);
+			file++;
+		} else if (code==FENSLASH) {
+			if (file!=8 || --rank<0)
+				return true;
+			file=0;
+		} else if (code>FENSLASH) {
+			file+=code-FENSLASH;
+			if (file>8)
+				return true;
+		} else
+			return true;
+	}
+	if (rank!=0 || file!=8 || !pieces[0][king] || !pieces[1][king])
+		return true;
+	whiteKing=lowestBit(pieces[0][king]);
+	blackKing=lowestBit(pieces[1][king]);
+
+	while (*p==' ') p++;
+	if (*p!='w' && *p!='b')
+		return true;
+	side=(*p++=='b') ? 1 : 0;
+
+	while (*p==' ') p++;
+	for (; *p && *p!=' '; p++) {
+		switch (*p) {
+		case 'K': castling|=1; break;
+		case 'Q': castling|=2; break;
+		case 'k': castling|=4; break;
+		case 'q': castling|=8; break;
+		case '-': break;
+		default: return true;
+		}
+	}
+
+	while (*p==' ') p++;
+	if (p[0]>='a' && p[0]<='h' && (p[1]=='3' || p[1]=='6'))
+		epSquare=(p[0]-'a')+8*(p[1]-'1');
+	return false;
+}
+
+uint64_t
+Position::Key(void)
+{
+	uint64_t key=side ? zobristSide : 0;
+	int rights=castling;
+
+	for (int c=0; c<2; c++)
+		for (int p=pawn; p<=king; p++)
+			for (uint64_t b=pieces[c][p]; b; b&=b-1)
+				key^=zobristPieces[c][p][lowestBit(b)];
+
+	if (whiteKing!=4)
+		rights&=~3;
+	if (blackKing!=60)
+		rights&=~12;
+	if (!(pieces[0][rook] & BIT(7)))
+		rights&=~1;
+	if (!(pieces[0][rook] & BIT(0)))
+		rights&=~2;
+	if (!(pieces[1][rook] & BIT(63)))
+		rights&=~4;
+	if (!(pieces[1][rook] & BIT(56)))
+		rights&=~8;
+	key^=zobristCastling[rights];
+
+	if (epSquare>=0) {
+		// the capturing pawns stand next to the pawn that was pushed
+		int f=epSquare&7;
+		int from=side ? epSquare+8 : epSquare-8;
+		uint64_t capturers=0;
+
+		if (f>0)
+			capturers|=BIT(from-1);
+		if (f<7)
+			capturers|=BIT(from+1);
+		if (pieces[side][pawn] & capturers)
+			key^=zobristEp[f];
+	}
+	return key;
+}
+
+void
+Position::Mirror(void)
+{
+	for (int p=pawn; p<=king; p++) {
+		uint64_t white=pieces[0][p];
+
+		pieces[0][p]=flipRanks(pieces[1][p]);
+		pieces[1][p]=flipRanks(white);
+	}
+	uint64_t white=occupied[0];
+	occupied[0]=flipRanks(occupied[1]);
+	occupied[1]=flipRanks(white);
+
+	int square=whiteKing;
+	whiteKing=blackKing^56;
+	blackKing=square^56;
+	side^=1;
+	castling=((castling & 3)<<2) | ((castling>>2) & 3);
+	if (epSquare>=0)
+		epSquare^=56;
+}
+
+int
+Position::MirrorMove(int move)
+{
+	// from and to move to the same file on the other side of the board
+	return move ? move ^ (56 | (56<<6)) : 0;
+}
+
+bool
+Position::White2Move(void)
+{
+	return side==0;
+}
+
+bool
+Position::Black2Move(void)
+{
+	return side==1;
+}
+
+bool
+Position::WhiteAttacks(int square)
+{
+	return Attacked(square,0);
+}
+
+bool
+Position::BlackAttacks(int square)
+{
+	return Attacked(square,1);
+}
+
+bool
+Position::InCheck(void)
+{
+	return Attacked(side ? blackKing : whiteKing,side^1);
+}
+
+int
+Position::GetPieceCount(void)
+{
+	int n=0;
+
+	for (uint64_t b=occupied[0] | occupied[1]; b; b&=b-1)
+		n++;
+	return n;
+}
+
+int
+Position::PieceAt(int square)
+{
+	uint64_t b=BIT(square);
+
+	for (int p=pawn; p<=king; p++)
+		if ((pieces[0][p] | pieces[1][p]) & b)
+			return p;
+	return nopiece;
+}
+
+bool
+Position::Attacked(int square, int by)
+{
+	uint64_t all=occupied[0] | occupied[1];
+	uint64_t pawns=pieces[by][pawn];
+	int f=square&7;
+
+	// a white pawn attacks the square from one rank below
+	if (by==0 && square>=8) {
+		if ((f>0 && (pawns & BIT(square-9))) || (f<7 && (pawns & BIT(square-7))))
+			return true;
+	}
+	if (by==1 && square<56) {
+		if ((f>0 && (pawns & BIT(square+7))) || (f<7 && (pawns & BIT(square+9))))
+			return true;
+	}
+	if (knightAttacks[square] & pieces[by][knight])
+		return true;
+	if (kingAttacks[square] & pieces[by][king])
+		return true;
+	if (ROOKATTACKS(square,all) & (pieces[by][rook] | pieces[by][queen]))
+		return true;
+	if (BISHOPATTACKS(square,all) & (pieces[by][bishop] | pieces[by][queen]))
+		return true;
+	return false;
+}
+
+void
+Position::MakeMove(int move)
+{
+	// only what is needed to see whether the own king is left in check
+	int from=move&63, to=(move>>6)&63, promo=(move>>12)&7;
+	int piece=PieceAt(from);
+	int them=side^1;
+
+	if (occupied[them] & BIT(to)) {
+		for (int p=pawn; p<=king; p++)
+			pieces[them][p]&=~BIT(to);
+		occupied[them]&=~BIT(to);
+	} else if (piece==pawn && to==epSquare) {
+		int captured=side ? to+8 : to-8;
+
+		pieces[them][pawn]&=~BIT(captured);
+		occupied[them]&=~BIT(captured);
+	}
+	pieces[side][piece]^=BIT(from);
+	pieces[side][promo ? promoPiece[promo] : piece]|=BIT(to);
+	occupied[side]^=BIT(from) | BIT(to);
+	if (piece==king) {
+		if (to-from==2 || from-to==2) {
+			// the rook jumps over the king
+			int rookFrom=to>from ? from+3 : from-4;
+			int rookTo=to>from ? from+1 : from-1;
+
+			pieces[side][rook]^=BIT(rookFrom) | BIT(rookTo);
+			occupied[side]^=BIT(rookFrom) | BIT(rookTo);
+		}
+		if (side) blackKing=to; else whiteKing=to;
+	}
+}
+
+bool
+Position::Castle(int* moves, int* n, int right, int rookFrom, int kingTo, uint64_t empty)
+{
+	// the king may not castle out of or through check, into check is
+	// found by the legality test
+	int kingFrom=side ? blackKing : whiteKing;
+	int passed=(kingFrom+kingTo)/2;
+
+	if (!(castling & right) || !(pieces[side][rook] & BIT(rookFrom))
+		|| kingFrom!=(side ? 60 : 4) || ((occupied[0] | occupied[1]) & empty))
+		return false;
+	if (Attacked(kingFrom,side^1) || Attacked(passed,side^1))
+		return false;
+	moves[(*n)++]=kingFrom + (kingTo<<6);
+	return true;
+}
+
+int
+Position::PseudoMoves(int* moves)
+{
+	uint64_t own=occupied[side], all=occupied[0] | occupied[1];
+	uint64_t b;
+	int n=0;
+	int up=side ? -8 : 8;
+	int startRank=side ? 6 : 1, lastRank=side ? 0 : 7;
+
+	// pawns
+	for (b=pieces[side][pawn]; b; b&=b-1) {
+		int from=lowestBit(b), f=from&7;
+		int targets[3], count=0;
+
+		if (!(all & BIT(from+up))) {
+			targets[count++]=from+up;
+			if ((from>>3)==startRank && !(all & BIT(from+2*up)))
+				moves[n++]=from + ((from+2*up)<<6);
+		}
+		if (f>0 && ((occupied[side^1] & BIT(from+up-1)) || from+up-1==epSquare))
+			targets[count++]=from+up-1;
+		if (f<7 && ((occupied[side^1] & BIT(from+up+1)) || from+up+1==epSquare))
+			targets[count++]=from+up+1;
+		for (int i=0; i<count; i++) {
+			if ((targets[i]>>3)==lastRank) {
+				for (int promo=1; promo<=4; promo++)
+					moves[n++]=from + (targets[i]<<6) + (promo<<12);
+			} else
+				moves[n++]=from + (targets[i]<<6);
+		}
+	}
+
+	// pieces
+	for (int p=knight; p<=king; p++) {
+		for (b=pieces[side][p]; b; b&=b-1) {
+			int from=lowestBit(b);
+			uint64_t to;
+
+			switch (p) {
+			case knight: to=knightAttacks[from]; break;
+			case bishop: to=BISHOPATTACKS(from,all); break;
+			case rook: to=ROOKATTACKS(from,all); break;
+			case queen: to=ROOKATTACKS(from,all) | BISHOPATTACKS(from,all); break;
+			default: to=kingAttacks[from]; break;
+			}
+			for (to&=~own; to; to&=to-1)
+				moves[n++]=from + (lowestBit(to)<<6);
+		}
+	}
+
+	// castling
+	if (side==0) {
+		Castle(moves,&n,1,7,6,BIT(5) | BIT(6));
+		Castle(moves,&n,2,0,2,BIT(1) | BIT(2) | BIT(3));
+	} else {
+		Castle(moves,&n,4,63,62,BIT(61) | BIT(62));
+		Castle(moves,&n,8,56,58,BIT(57) | BIT(58) | BIT(59));
+	}
+	return n;
+}
+
+bool
+Position::KingSafeAfter(int move)
+{
+	Position after=*this;
+
+	after.MakeMove(move);
+	return !after.Attacked(side ? after.blackKing : after.whiteKing,side^1);
+}
+
+int
+Position::GenerateMoves(int* moves)
+{
+	int pseudo[MAXMOVES];
+	int count=PseudoMoves(pseudo);
+	int n=0;
+
+	for (int i=0; i<count; i++)
+		if (KingSafeAfter(pseudo[i]))
+			moves[n++]=pseudo[i];
+	return n;
+}
+
+bool
+Position::IsLegal(int move)
+{
+	int moves[MAXMOVES];
+	int n=PseudoMoves(moves);
+
+	for (int i=0; i<n; i++)
+		if (moves[i]==move)
+			return KingSafeAfter(move);
+	return false;
+}
+
+int
+Position::ParseMove(const char* s)
+{
+	static const char pieceChars[]="PNBRQK";
+	int moves[MAXMOVES];
+	char buf[16];
+	int len, n, match=0, found=0;
+	int piece=pawn, fromFile=-1, fromRank=-1, to, promo=0;
+	const char* c;
+
+	// without check, capture and annotation marks
+	len=(int)strcspn(s," \t\r\n");
+	if (len>=(int)sizeof(buf))
+		return 0;
+	memcpy(buf,s,len);
+	while (len>0 && strchr("+#!?",buf[len-1]))
+		len--;
+	buf[len]='\0';
+
+	// only the moves matching the text are tested for legality
+	n=PseudoMoves(moves);
+
+	if (strcmp(buf,"O-O")==0 || strcmp(buf,"0-0")==0 || strcmp(buf,"O-O-O")==0 || strcmp(buf,"0-0-0")==0) {
+		int from=side ? blackKing : whiteKing;
+		int move=from + ((len==3 ? from+2 : from-2)<<6);
+
+		for (int i=0; i<n; i++)
+			if (moves[i]==move)
+				return KingSafeAfter(move) ? move : 0;
+		return 0;
+	}
+
+	// coordinates, optionally with - or x between the squares
+	if (len>=4 && buf[0]>='a' && buf[0]<='h' && buf[1]>='1' && buf[1]<='8') {
+		int k=(buf[2]=='-' || buf[2]=='x') ? 3 : 2;
+
+		if (buf[k]>='a' && buf[k]<='h' && buf[k+1]>='1' && buf[k+1]<='8') {
+			int from=(buf[0]-'a')+8*(buf[1]-'1');
+			const char* p=buf+k+2;
+			int promoted=0;
+
+			to=(buf[k]-'a')+8*(buf[k+1]-'1');
+			if (*p=='=') p++;
+			if (*p) {
+				if ((c=strchr(promoChar+1,tolower(*p)))==0 || p[1])
+					return 0;
+				promoted=(int)(c-promoChar);
+			}
+			// the king onto its own rook is castling
+			if (from==(side ? blackKing : whiteKing) && (pieces[side][rook] & BIT(to))
+				&& (from>>3)==(to>>3))
+				to=to>from ? from+2 : from-2;
+			for (int i=0; i<n; i++) {
+				if ((moves[i]&0xfff)!=from+(to<<6))
+					continue;
+				// a promotion without a piece is taken to be a queen
+				if ((moves[i]>>12)==promoted || (!promoted && (moves[i]>>12)==1))
+					return KingSafeAfter(moves[i]) ? moves[i] : 0;
+			}
+			return 0;
+		}
+	}
+
+	// SAN: [piece][file][rank][x]square[=promotion]
+	c=buf;
+	if (*c && strchr(pieceChars,*c)) {
+		piece=(int)(strchr(pieceChars,*c)-pieceChars);
+		c++;
+	}
+	len=(int)strlen(c);
+	if (len>=2 && strchr("QRBNqrbn",c[len-1]) && (c[len-2]=='=' || (c[len-2]>='1' && c[len-2]<='8'))) {
+		promo=(int)(strchr(promoChar+1,tolower(c[len-1]))-promoChar);
+		len-=c[len-2]=='=' ? 2 : 1;
+	}
+	if (len<2 || c[len-2]<'a' || c[len-2]>'h' || c[len-1]<'1' || c[len-1]>'8')
+		return 0;
+	to=(c[len-2]-'a')+8*(c[len-1]-'1');
+	for (int i=0; i<len-2; i++) {
+		if (c[i]>='a' && c[i]<='h')
+			fromFile=c[i]-'a';
+		else if (c[i]>='1' && c[i]<='8')
+			fromRank=c[i]-'1';
+		else if (c[i]!='x' && c[i]!=':')
+			return 0;
+	}
+	for (int i=0; i<n; i++) {
+		int from=moves[i]&63;
+
+		if (((moves[i]>>6)&63)!=to || (moves[i]>>12)!=promo || PieceAt(from)!=piece)
+			continue;
+		if ((fromFile>=0 && (from&7)!=fromFile) || (fromRank>=0 && (from>>3)!=fromRank))
+			continue;
+		if (!KingSafeAfter(moves[i]))
+			continue;
+		match=moves[i];
+		found++;
+	}
+	return found==1 ? match : 0;
+}
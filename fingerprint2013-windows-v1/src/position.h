@@ -0,0 +1,73 @@
+// Position.h
+// Bitboard chess position for validating the moves of engines
+//
+// Copyright (C) 2008-2013, ir. R.L. Pijl
+
+#ifndef __POSITION_H
+#define __POSITION_H
+
+#include <stdint.h>
+
+// Squares are numbered a1=0, b1=1 .. h8=63. Moves use the encoding of
+// ParseMove in util.h: from + (to<<6) + (promotion<<12), with promotion
+// 1=q, 2=r, 3=b, 4=n. Castling is the king move, e1g1.
+class Position
+{
+public:
+	Position();
+
+	// Placement, side to move, castling and en passant are used, the move
+	// counters may be left out. Returns true when the FEN is not valid.
+	bool SetFEN(const char* fen);
+
+	bool White2Move(void);
+	bool Black2Move(void);
+	bool WhiteAttacks(int square);
+	bool BlackAttacks(int square);
+	bool InCheck(void);
+	int GetPieceCount(void);
+
+	enum { MAXMOVES=256 };
+	int GenerateMoves(int* moves);
+	bool IsLegal(int move);
+
+	// A move as an engine may write it: coordinates (e2e4, e7e8q, e7e8=Q,
+	// e2-e4), castling (O-O, 0-0-0, or the king onto its own rook) or SAN
+	// (Nbd7, exd5, e8=Q+). Returns the legal move, 0 when the text is not
+	// a legal move in this position.
+	int ParseMove(const char* s);
+
+	// Zobrist key of the four FEN fields. Castling rights without their
+	// king and rook, and an en passant square no pawn can capture on, do
+	// not count, so equal positions get equal keys however they are written.
+	uint64_t Key(void);
+
+	// Swap the colours and flip the board vertically, the side to move
+	// changes as well. MirrorMove gives the corresponding move.
+	void Mirror(void);
+	static int MirrorMove(int move);
+
+	int whiteKing;
+	int blackKing;
+
+	typedef enum {
+		pawn=0, knight, bishop, rook, queen, king, nopiece
+	} piece_t;
+
+private:
+
+	uint64_t pieces[2][6];
+	uint64_t occupied[2];
+	int side;
+	int castling;		// 1 white O-O, 2 white O-O-O, 4 black O-O, 8 black O-O-O
+	int epSquare;		// square passed by a double pawn push, -1 for none
+
+	int PieceAt(int square);
+	bool Attacked(int square, int by);
+	void MakeMove(int move);
+	bool KingSafeAfter(int move);
+	int PseudoMoves(int* moves);
+	bool Castle(int* moves, int* n, int right, int rookFrom, int kingTo, uint64_t empty);
+};
+
+#endif // __POSITION_H
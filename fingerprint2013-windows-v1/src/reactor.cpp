@@ -0,0 +1,435 @@
+// Reactor.cpp
+//
+// Copyright (C) 2008-2013, ir. R.L. Pijl
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <errno.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#else
+#include <poll.h>
+#endif
+#endif
+
+#include "reactor.h"
+#include "engine.h"
+
+Reactor* Reactor::instance=0;
+Mutex Reactor::instanceLock;
+
+int reactorThread(void* param)
+{
+	((Reactor*)param)->Run();
+	return 0;
+}
+
+Reactor::Reactor()
+{
+	count=0;
+	for (int i=0; i<WHEELSIZE; i++) wheel[i]=0;
+	wheelPos=0;
+	timerCount=0;
+	timerSeq=0;
+	wheelTime=TimeMs();
+	expired=0;
+	runningTimer=0;
+	pollFd=-1;
+	wakeup[0]=wakeup[1]=-1;
+}
+
+Reactor::~Reactor()
+{
+	// the reactor lives as long as the program
+}
+
+Reactor*
+Reactor::Get(void)
+{
+	instanceLock.Lock();
+	if (!instance) {
+		instance=new Reactor;
+		if (instance->Start()) {
+			delete instance;
+			instance=0;
+		}
+	}
+	instanceLock.Unlock();
+	return instance;
+}
+
+bool
+Reactor::Start(void)
+{
+#ifndef _WIN32
+	if (pipe(wakeup)==-1)
+		return true;
+	fcntl(wakeup[0],F_SETFD,FD_CLOEXEC);
+	fcntl(wakeup[1],F_SETFD,FD_CLOEXEC);
+	fcntl(wakeup[0],F_SETFL,O_NONBLOCK);
+	fcntl(wakeup[1],F_SETFL,O_NONBLOCK);
+#ifdef __linux__
+	struct epoll_event ev;
+
+	pollFd=epoll_create1(EPOLL_CLOEXEC);
+	if (pollFd==-1)
+		return true;
+	ev.events=EPOLLIN;
+	ev.data.ptr=0;
+	if (epoll_ctl(pollFd,EPOLL_CTL_ADD,wakeup[0],&ev)==-1)
+		return true;
+#endif
+#endif
+	return StartThread(reactorThread,this);
+}
+
+void
+Reactor::Wakeup(void)
+{
+#ifdef _WIN32
+	timerAdded.Signal();
+#else
+	char c=0;
+
+	if (write(wakeup[1],&c,1)==-1) {
+		// pipe full, the reactor will wake up anyway
+	}
+#endif
+}
+
+int
+Reactor::Find(Engine* engine)
+{
+	// called with the lock held
+	for (int i=0; i<count; i++)
+		if (engines[i]==engine) return i;
+	return -1;
+}
+
+void
+Reactor::Unregister(int i)
+{
+	// called with the lock held
+#ifdef __linux__
+	epoll_ctl(pollFd,EPOLL_CTL_DEL,fds[i],0);
+#endif
+	count--;
+	engines[i]=engines[count];
+	fds[i]=fds[count];
+	busy[i]=busy[count];
+}
+
+#ifdef _WIN32
+
+typedef struct {
+	Reactor* reactor;
+	Engine* engine;
+	int fd;
+} reader_t;
+
+int readerThread(void* param)
+{
+	// Anonymous pipes cannot be waited on, so on Windows every engine gets
+	// one reader thread for its whole life time. Timers still run on the
+	// reactor thread.
+	reader_t reader=*(reader_t*)param;
+	char data[4096];
+	int n;
+
+	delete (reader_t*)param;
+	do {
+		n=_read(reader.fd,data,sizeof(data));
+	} while (!reader.reactor->Deliver(reader.engine,data,n));
+	return 0;
+}
+
+#endif
+
+bool
+Reactor::Add(Engine* engine, int fd)
+{
+	lock.Lock();
+	if (count==MAXENGINES) {
+		lock.Unlock();
+		return true;
+	}
+	engines[count]=engine;
+	fds[count]=fd;
+	busy[count]=false;
+	count++;
+#ifdef __linux__
+	struct epoll_event ev;
+
+	ev.events=EPOLLIN;
+	ev.data.ptr=engine;
+	if (epoll_ctl(pollFd,EPOLL_CTL_ADD,fd,&ev)==-1) {
+		count--;
+		lock.Unlock();
+		return true;
+	}
+#endif
+	lock.Unlock();
+
+#ifdef _WIN32
+	reader_t* reader=new reader_t;
+
+	reader->reactor=this;
+	reader->engine=engine;
+	reader->fd=fd;
+	if (StartThread(readerThread,reader)) {
+		delete reader;
+		Remove(engine);
+		return true;
+	}
+#elif !defined(__linux__)
+	Wakeup();
+#endif
+	return false;
+}
+
+void
+Reactor::Remove(Engine* engine)
+{
+	int i;
+
+	lock.Lock();
+	// an engine must not disappear while its output is being handled
+	while ((i=Find(engine))>=0 && busy[i])
+		dispatched.Wait(lock);
+	if (i>=0)
+		Unregister(i);
+	lock.Unlock();
+#if !defined(_WIN32) && !defined(__linux__)
+	Wakeup();
+#endif
+}
+
+bool
+Reactor::Deliver(Engine* engine, const char* data, int n)
+{
+	int i;
+
+	// the engine may have been removed while its data was read
+	lock.Lock();
+	i=Find(engine);
+	if (i<0) {
+		lock.Unlock();
+		return true;
+	}
+	busy[i]=true;
+	lock.Unlock();
+
+	if (n>0)
+		engine->InputAvailable(data,n);
+	else
+		engine->InputClosed();
+
+	lock.Lock();
+	if ((i=Find(engine))>=0) {
+		busy[i]=false;
+		if (n<=0)
+			Unregister(i);
+	}
+	dispatched.Broadcast();
+	lock.Unlock();
+	return n<=0;
+}
+
+bool
+Reactor::Dispatch(Engine* engine)
+{
+	char data[4096];
+	int i, fd, n;
+
+	lock.Lock();
+	i=Find(engine);
+	if (i<0) {
+		lock.Unlock();
+		return true;
+	}
+	fd=fds[i];
+	lock.Unlock();
+
+#ifdef _WIN32
+	n=_read(fd,data,sizeof(data));
+#else
+	n=read(fd,data,sizeof(data));
+	if (n<0 && (errno==EINTR || errno==EAGAIN))
+		return false;
+#endif
+	return Deliver(engine,data,n);
+}
+
+int
+Reactor::AddTimer(int milliseconds, timerFunction func, void* param)
+{
+	wheelTimer_t* timer=new wheelTimer_t;
+	int ticks=(milliseconds+TICK-1)/TICK;
+	int id;
+
+	if (ticks<1) ticks=1;
+
+	lock.Lock();
+	id=++timerSeq;
+	if (id==0) id=++timerSeq;
+	timer->id=id;
+	timer->rounds=(ticks-1)/WHEELSIZE;
+	timer->func=func;
+	timer->param=param;
+	timer->next=wheel[(wheelPos+ticks)%WHEELSIZE];
+	wheel[(wheelPos+ticks)%WHEELSIZE]=timer;
+	if (timerCount++==0)
+		wheelTime=TimeMs();
+	lock.Unlock();
+
+	Wakeup();
+	return id;
+}
+
+void
+Reactor::CancelTimer(int id)
+{
+	if (id==0) return;
+
+	lock.Lock();
+	for (int i=0; i<WHEELSIZE; i++) {
+		for (wheelTimer_t** t=&wheel[i]; *t; t=&(*t)->next) {
+			if ((*t)->id==id) {
+				wheelTimer_t* timer=*t;
+
+				*t=timer->next;
+				delete timer;
+				timerCount--;
+				lock.Unlock();
+				return;
+			}
+		}
+	}
+	// due, but its function was not called yet
+	for (wheelTimer_t** t=&expired; *t; t=&(*t)->next) {
+		if ((*t)->id==id) {
+			wheelTimer_t* timer=*t;
+
+			*t=timer->next;
+			delete timer;
+			lock.Unlock();
+			return;
+		}
+	}
+	// the function may use what the caller is about to release
+	while (runningTimer==id)
+		timerDone.Wait(lock);
+	lock.Unlock();
+}
+
+void
+Reactor::AdvanceTimers(void)
+{
+	unsigned long long now=TimeMs();
+
+	lock.Lock();
+	if (timerCount==0) {
+		wheelTime=now;
+		lock.Unlock();
+		return;
+	}
+	while (wheelTime+TICK<=now) {
+		wheelTime+=TICK;
+		wheelPos=(wheelPos+1)%WHEELSIZE;
+		for (wheelTimer_t** t=&wheel[wheelPos]; *t; ) {
+			wheelTimer_t* timer=*t;
+
+			if (timer->rounds>0) {
+				timer->rounds--;
+				t=&timer->next;
+				continue;
+			}
+			*t=timer->next;
+			timer->next=expired;
+			expired=timer;
+			timerCount--;
+		}
+
+		// timer functions may add or cancel timers themselves, so they are
+		// called one by one without the lock
+		while (expired) {
+			wheelTimer_t* timer=expired;
+
+			expired=timer->next;
+			runningTimer=timer->id;
+			lock.Unlock();
+			timer->func(timer->param);
+			delete timer;
+			lock.Lock();
+			runningTimer=0;
+			timerDone.Broadcast();
+		}
+	}
+	lock.Unlock();
+}
+
+void
+Reactor::Run(void)
+{
+	for (;;) {
+		int timeout;
+
+		lock.Lock();
+		timeout=timerCount ? TICK : -1;
+#ifdef _WIN32
+		// engine output is handled by the reader threads
+		if (timeout<0)
+			timerAdded.Wait(lock);
+		lock.Unlock();
+		if (timeout>0)
+			Sleep(TICK);
+#elif defined(__linux__)
+		lock.Unlock();
+
+		struct epoll_event events[64];
+		int n=epoll_wait(pollFd,events,64,timeout);
+
+		for (int i=0; i<n; i++) {
+			if (events[i].data.ptr==0) {
+				char drain[64];
+
+				while (read(wakeup[0],drain,sizeof(drain))>0);
+				continue;
+			}
+			Dispatch((Engine*)events[i].data.ptr);
+		}
+#else
+		struct pollfd pfd[MAXENGINES+1];
+		Engine* pe[MAXENGINES+1];
+		int m=1;
+
+		pfd[0].fd=wakeup[0];
+		pfd[0].events=POLLIN;
+		for (int i=0; i<count; i++) {
+			pfd[m].fd=fds[i];
+			pfd[m].events=POLLIN;
+			pe[m++]=engines[i];
+		}
+		lock.Unlock();
+
+		int n=poll(pfd,m,timeout);
+
+		for (int i=0; n>0 && i<m; i++) {
+			if (!pfd[i].revents) continue;
+			if (i==0) {
+				char drain[64];
+
+				while (read(wakeup[0],drain,sizeof(drain))>0);
+				continue;
+			}
+			Dispatch(pe[i]);
+		}
+#endif
+		AdvanceTimers();
+	}
+}
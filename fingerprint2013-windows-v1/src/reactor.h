@@ -0,0 +1,87 @@
+// Reactor.h
+// Single event loop collecting the output of all running engines
+//
+// Copyright (C) 2008-2013, ir. R.L. Pijl
+
+#ifndef __REACTOR_H
+#define __REACTOR_H
+
+#include "platform.h"
+
+class Engine;
+
+class Reactor
+{
+public:
+	typedef void (*timerFunction)(void* param);
+
+	// The reactor thread is started on first use
+	static Reactor* Get(void);
+
+	// Engine output on fd is read by the reactor from now on until the
+	// engine closes it or the engine is removed.
+	bool Add(Engine* engine, int fd);
+	void Remove(Engine* engine);
+
+	// One-shot timers with a resolution of one tick. Returns the timer id,
+	// or 0 on error. Timer functions run on the reactor thread. When
+	// CancelTimer returns the function is not running and will not run, so
+	// a timer function must not cancel its own timer.
+	int AddTimer(int milliseconds, timerFunction func, void* param);
+	void CancelTimer(int id);
+
+private:
+	Reactor();
+	~Reactor();
+
+	bool Start(void);
+	void Run(void);
+	void AdvanceTimers(void);
+	bool Dispatch(Engine* engine);
+	bool Deliver(Engine* engine, const char* data, int n);
+	int Find(Engine* engine);
+	void Unregister(int i);
+	void Wakeup(void);
+
+	friend int reactorThread(void* param);
+	friend int readerThread(void* param);
+
+	enum { MAXENGINES=1024, WHEELSIZE=256, TICK=10 };
+
+	typedef struct timer_s {
+		int id;
+		int rounds;
+		timerFunction func;
+		void* param;
+		struct timer_s* next;
+	} wheelTimer_t;
+
+	Engine* engines[MAXENGINES];
+	int fds[MAXENGINES];
+	bool busy[MAXENGINES];
+	int count;
+
+	// Timer wheel: a timer due in n ticks is put in slot (pos+n)%WHEELSIZE
+	// and survives n/WHEELSIZE passes of the wheel.
+	wheelTimer_t* wheel[WHEELSIZE];
+	int wheelPos;
+	int timerCount;
+	int timerSeq;
+	unsigned long long wheelTime;
+
+	// timers that are due, and the one whose function is running
+	wheelTimer_t* expired;
+	int runningTimer;
+
+	Mutex lock;
+	Condition timerAdded;
+	Condition timerDone;
+	Condition dispatched;
+	int pollFd;
+	int wakeup[2];
+
+	static Reactor* instance;
+	static Mutex instanceLock;
+};
+
+#endif // __REACTOR_H
@@ -0,0 +1,262 @@
+// ResultCache.cpp
+//
+// Copyright (C) 2008-2013, ir. R.L. Pijl
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "resultcache.h"
+#include "platform.h"
+#include "util.h"
+
+// A line that was only partly written when a run was interrupted is closed
+// with a '!' before anything is appended, so it never parses. A later entry
+// for the same key wins.
+
+ResultCache::ResultCache()
+{
+	fp=0;
+	memset(settings,0,sizeof(settings));
+	entries=0;
+	entryCount=0;
+	entrySize=0;
+	table=0;
+	tableMask=0;
+	unflushed=0;
+}
+
+ResultCache::~ResultCache()
+{
+	Close();
+	Free();
+}
+
+void
+ResultCache::Free(void)
+{
+	free(entries);
+	delete[] table;
+	entries=0;
+	table=0;
+	entryCount=entrySize=0;
+	tableMask=0;
+}
+
+bool
+ResultCache::Open(const char* name, const unsigned char s[Sha256::DIGESTSIZE])
+{
+	MappedFile file;
+	bool terminated=true;
+
+	Close();
+	Free();
+	memcpy(settings,s,sizeof(settings));
+	entrySize=1024;
+	entries=(entry_t*)malloc(entrySize*sizeof(entry_t));
+	table=new int[2*entrySize];
+	tableMask=2*entrySize-1;
+	memset(table,-1,2*entrySize*sizeof(int));
+
+	// the mapping is closed again before appending, Windows does not allow
+	// writing to a file that is mapped
+	if (!file.Open(name)) {
+		const char* data=(const char*)file.GetData();
+		const char* end=data+file.GetSize();
+
+		while (data<end) {
+			const char* eol=(const char*)memchr(data,'\n',end-data);
+
+			if (!eol) {
+				terminated=false;
+				break;
+			}
+			ParseLine(data,(int)(eol-data));
+			data=eol+1;
+		}
+		file.Close();
+	}
+
+	fp=fopen(name,"a");
+	if (!fp)
+		return true;
+	if (!terminated)
+		fputs("!\n",fp);
+	return false;
+}
+
+bool
+ResultCache::Close(void)
+{
+	bool rv=false;
+
+	if (fp) {
+		rv=fclose(fp)!=0;
+		fp=0;
+	}
+	return rv;
+}
+
+static bool parseHex(const char* s, uint64_t* value)
+{
+	*value=0;
+	for (int i=0; i<16; i++) {
+		int c=s[i];
+
+		if (c>='0' && c<='9')
+			c-='0';
+		else if (c>='a' && c<='f')
+			c-='a'-10;
+		else
+			return true;
+		*value=(*value<<4) | c;
+	}
+	return false;
+}
+
+static bool validMove(const char* s)
+{
+	size_t n=strlen(s);
+
+	return (n==4 || (n==5 && strchr("qrbn",s[4])))
+		&& s[0]>='a' && s[0]<='h' && s[1]>='1' && s[1]<='8'
+		&& s[2]>='a' && s[2]<='h' && s[3]>='1' && s[3]<='8';
+}
+
+bool
+ResultCache::ParseLine(const char* line, int length)
+{
+	char buf[256];
+	char *s, *next=buf;
+	uint64_t key[2];
+	int move, top[MAXTOP], n=0;
+
+	if (length<34 || length>=(int)sizeof(buf) || line[32]!=' '
+		|| parseHex(line,&key[0]) || parseHex(line+16,&key[1]))
+		return true;
+	memcpy(buf,line+33,length-33);
+	buf[length-33]='\0';
+	s=NextToken(&next," \t\r");
+	if (!s || !validMove(s))
+		return true;
+	move=ParseMove(s);
+	while (n<MAXTOP && (s=NextToken(&next," \t\r"))) {
+		if (!validMove(s))
+			return true;
+		top[n++]=ParseMove(s);
+	}
+	Insert(key,move,top,n);
+	return false;
+}
+
+void
+ResultCache::MakeKey(uint64_t position, uint64_t key[2])
+{
+	Sha256 sha;
+	unsigned char digest[Sha256::DIGESTSIZE];
+	unsigned char p[8];
+
+	for (int i=0; i<8; i++)
+		p[i]=(unsigned char)(position>>(8*i));
+	sha.Update(settings,sizeof(settings));
+	sha.Update(p,sizeof(p));
+	sha.Final(digest);
+	key[0]=key[1]=0;
+	for (int i=0; i<8; i++) {
+		key[0]=(key[0]<<8) | digest[i];
+		key[1]=(key[1]<<8) | digest[8+i];
+	}
+}
+
+int
+ResultCache::Find(const uint64_t key[2])
+{
+	for (unsigned int slot=(unsigned int)key[1] & tableMask; table[slot]>=0; slot=(slot+1) & tableMask) {
+		entry_t* e=&entries[table[slot]];
+
+		if (e->key[0]==key[0] && e->key[1]==key[1])
+			return table[slot];
+	}
+	return -1;
+}
+
+void
+ResultCache::Insert(const uint64_t key[2], int move, const int* top, int n)
+{
+	int i=Find(key);
+	entry_t* e;
+
+	if (i<0) {
+		if (entryCount==entrySize) {
+			// the table stays at most half full
+			entrySize*=2;
+			entries=(entry_t*)realloc(entries,entrySize*sizeof(entry_t));
+			delete[] table;
+			table=new int[2*entrySize];
+			tableMask=2*entrySize-1;
+			memset(table,-1,2*entrySize*sizeof(int));
+			for (int k=0; k<entryCount; k++) {
+				unsigned int slot=(unsigned int)entries[k].key[1] & tableMask;
+
+				while (table[slot]>=0)
+					slot=(slot+1) & tableMask;
+				table[slot]=k;
+			}
+		}
+		i=entryCount++;
+		unsigned int slot=(unsigned int)key[1] & tableMask;
+		while (table[slot]>=0)
+			slot=(slot+1) & tableMask;
+		table[slot]=i;
+	}
+	e=&entries[i];
+	e->key[0]=key[0];
+	e->key[1]=key[1];
+	e->move=move;
+	if (n>MAXTOP) n=MAXTOP;
+	memcpy(e->top,top,n*sizeof(int));
+	e->topCount=n;
+}
+
+bool
+ResultCache::Lookup(uint64_t position, int* move, int* top, int* topCount)
+{
+	uint64_t key[2];
+	int i;
+
+	MakeKey(position,key);
+	i=Find(key);
+	if (i<0)
+		return false;
+	*move=entries[i].move;
+	memcpy(top,entries[i].top,entries[i].topCount*sizeof(int));
+	*topCount=entries[i].topCount;
+	return true;
+}
+
+bool
+ResultCache::Append(uint64_t position, int move, const int* top, int n)
+{
+	uint64_t key[2];
+
+	if (!fp)
+		return true;
+	MakeKey(position,key);
+	Insert(key,move,top,n);
+
+	fprintf(fp,"%016llx%016llx %s",(unsigned long long)key[0],(unsigned long long)key[1],MoveStr(move));
+	for (int i=0; i<n && i<MAXTOP; i++)
+		fprintf(fp," %s",MoveStr(top[i]));
+	fprintf(fp,"\n");
+	if (++unflushed>=FLUSHINTERVAL) {
+		unflushed=0;
+		return fflush(fp)!=0;
+	}
+	return false;
+}
+
+int
+ResultCache::GetEntryCount(void)
+{
+	return entryCount;
+}
@@ -0,0 +1,63 @@
+// ResultCache.h
+// Results of earlier runs, keyed by the settings and the position
+//
+// Copyright (C) 2008-2013, ir. R.L. Pijl
+
+#ifndef __RESULTCACHE_H
+#define __RESULTCACHE_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include "sha256.h"
+
+// An append-only log with a line '<key> <move> [<ranked moves>]' per
+// search. The key is the first 128 bits of the SHA-256 of the settings
+// digest of the pool and the Zobrist key of the position, so one log can
+// hold the results of any number of engines and settings.
+class ResultCache
+{
+public:
+	ResultCache();
+	virtual ~ResultCache();
+
+	// Indexes the log through a memory mapping and opens it for appending.
+	// Returns true on error.
+	bool Open(const char* name, const unsigned char settings[Sha256::DIGESTSIZE]);
+	bool Close(void);
+
+	enum { MAXTOP=8 };
+
+	// Returns true when the position was searched before with the same
+	// settings, with the moves of that search
+	bool Lookup(uint64_t position, int* move, int* top, int* topCount);
+	bool Append(uint64_t position, int move, const int* top=0, int topCount=0);
+
+	int GetEntryCount(void);
+
+private:
+	typedef struct {
+		uint64_t key[2];
+		int move;
+		int top[MAXTOP];
+		int topCount;
+	} entry_t;
+
+	FILE* fp;
+	unsigned char settings[Sha256::DIGESTSIZE];
+	entry_t* entries;
+	int entryCount;
+	int entrySize;
+	int* table;		// open addressing on the keys, -1 is empty
+	unsigned int tableMask;
+	int unflushed;
+
+	enum { FLUSHINTERVAL=64 };
+
+	void MakeKey(uint64_t position, uint64_t key[2]);
+	int Find(const uint64_t key[2]);
+	void Insert(const uint64_t key[2], int move, const int* top, int topCount);
+	bool ParseLine(const char* line, int length);
+	void Free(void);
+};
+
+#endif // __RESULTCACHE_H
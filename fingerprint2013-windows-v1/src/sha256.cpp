@@ -0,0 +1,130 @@
+// Sha256.cpp
+//
+// Copyright (C) 2008-2013, ir. R.L. Pijl
+
+#include <stdio.h>
+#include <string.h>
+#include "sha256.h"
+
+static const uint32_t k[64]={
+	0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+	0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+	0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+	0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+	0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+	0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+	0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+	0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+#define ROTR(x,n) (((x)>>(n)) | ((x)<<(32-(n))))
+
+Sha256::Sha256()
+{
+	Reset();
+}
+
+void
+Sha256::Reset(void)
+{
+	static const uint32_t initial[8]={
+		0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+	};
+
+	memcpy(state,initial,sizeof(state));
+	length=0;
+	used=0;
+}
+
+void
+Sha256::Transform(const unsigned char* data)
+{
+	uint32_t w[64];
+	uint32_t a, b, c, d, e, f, g, h;
+
+	for (int i=0; i<16; i++)
+		w[i]=(uint32_t)data[4*i]<<24 | (uint32_t)data[4*i+1]<<16 | (uint32_t)data[4*i+2]<<8 | data[4*i+3];
+	for (int i=16; i<64; i++) {
+		uint32_t s0=ROTR(w[i-15],7) ^ ROTR(w[i-15],18) ^ (w[i-15]>>3);
+		uint32_t s1=ROTR(w[i-2],17) ^ ROTR(w[i-2],19) ^ (w[i-2]>>10);
+
+		w[i]=w[i-16]+s0+w[i-7]+s1;
+	}
+
+	a=state[0]; b=state[1]; c=state[2]; d=state[3];
+	e=state[4]; f=state[5]; g=state[6]; h=state[7];
+	for (int i=0; i<64; i++) {
+		uint32_t t1=h+(ROTR(e,6) ^ ROTR(e,11) ^ ROTR(e,25))+((e & f) ^ (~e & g))+k[i]+w[i];
+		uint32_t t2=(ROTR(a,2) ^ ROTR(a,13) ^ ROTR(a,22))+((a & b) ^ (a & c) ^ (b & c));
+
+		h=g; g=f; f=e; e=d+t1;
+		d=c; c=b; b=a; a=t1+t2;
+	}
+	state[0]+=a; state[1]+=b; state[2]+=c; state[3]+=d;
+	state[4]+=e; state[5]+=f; state[6]+=g; state[7]+=h;
+}
+
+void
+Sha256::Update(const void* data, size_t n)
+{
+	const unsigned char* p=(const unsigned char*)data;
+
+	length+=n;
+	while (n>0) {
+		size_t part=(size_t)(64-used)<n ? (size_t)(64-used) : n;
+
+		memcpy(block+used,p,part);
+		used+=(int)part;
+		p+=part;
+		n-=part;
+		if (used==64) {
+			Transform(block);
+			used=0;
+		}
+	}
+}
+
+void
+Sha256::Final(unsigned char digest[DIGESTSIZE])
+{
+	uint64_t bits=length*8;
+	unsigned char pad=0x80;
+
+	Update(&pad,1);
+	pad=0;
+	while (used!=56)
+		Update(&pad,1);
+	for (int i=7; i>=0; i--) {
+		unsigned char c=(unsigned char)(bits>>(8*i));
+
+		Update(&c,1);
+	}
+	for (int i=0; i<8; i++) {
+		digest[4*i]=(unsigned char)(state[i]>>24);
+		digest[4*i+1]=(unsigned char)(state[i]>>16);
+		digest[4*i+2]=(unsigned char)(state[i]>>8);
+		digest[4*i+3]=(unsigned char)state[i];
+	}
+	Reset();
+}
+
+bool
+Sha256::HashFile(const char* name, unsigned char digest[DIGESTSIZE])
+{
+	Sha256 sha;
+	unsigned char buf[65536];
+	size_t n;
+	FILE* fp=fopen(name,"rb");
+
+	if (!fp)
+		return true;
+	while ((n=fread(buf,1,sizeof(buf),fp))>0)
+		sha.Update(buf,n);
+	if (ferror(fp)) {
+		fclose(fp);
+		return true;
+	}
+	fclose(fp);
+	sha.Final(digest);
+	return false;
+}
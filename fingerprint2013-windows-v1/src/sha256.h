@@ -0,0 +1,36 @@
+// Sha256.h
+// SHA-256 message digest (FIPS 180-4)
+//
+// Copyright (C) 2008-2013, ir. R.L. Pijl
+
+#ifndef __SHA256_H
+#define __SHA256_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+class Sha256
+{
+public:
+	Sha256();
+
+	enum { DIGESTSIZE=32 };
+
+	void Update(const void* data, size_t length);
+	// Completes the digest, after which the object starts over
+	void Final(unsigned char digest[DIGESTSIZE]);
+
+	// Digest of a whole file, returns true when it could not be read
+	static bool HashFile(const char* name, unsigned char digest[DIGESTSIZE]);
+
+private:
+	uint32_t state[8];
+	uint64_t length;
+	unsigned char block[64];
+	int used;
+
+	void Reset(void);
+	void Transform(const unsigned char* data);
+};
+
+#endif // __SHA256_H
@@ -0,0 +1,163 @@
+// simcompare.cpp
+// Similarity matrix of a collection of fingerprints
+//
+// Copyright (C) 2013, ir. R.L. Pijl
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fpset.h"
+#include "platform.h"
+
+// The matrix is computed in square tiles of TILE x TILE fingerprints, so the
+// rows of one tile stay in the cache while they are compared to each other.
+#define TILE 32
+
+FingerprintSet fingerprints;
+int* matrix;
+int count;
+int tiles;
+int nextTile=0;
+int runningThreads=0;
+Mutex lock;
+Condition allDone;
+
+static int compareThread(void*)
+{
+	for (;;) {
+		int t, ti, tj;
+
+		lock.Lock();
+		t=nextTile++;
+		lock.Unlock();
+		if (t>=tiles*tiles) break;
+
+		// only the upper triangle, the matrix is symmetric
+		ti=t/tiles;
+		tj=t%tiles;
+		if (tj<ti) continue;
+
+		for (int i=ti*TILE; i<(ti+1)*TILE && i<count; i++)
+			for (int j=(i>tj*TILE ? i : tj*TILE); j<(tj+1)*TILE && j<count; j++)
+				matrix[i*count+j]=matrix[j*count+i]=fingerprints.Agreement(i,j);
+	}
+
+	lock.Lock();
+	if (--runningThreads==0)
+		allDone.Broadcast();
+	lock.Unlock();
+	return 0;
+}
+
+static bool loadList(const char* name)
+{
+	char buf[1024];
+	FILE* fp=fopen(name,"r");
+
+	if (!fp) {
+		fprintf(stderr,"ERROR: Could not open %s\n",name);
+		return true;
+	}
+	while (fgets(buf,sizeof(buf),fp)) {
+		buf[strcspn(buf,"\n\r")]='\0';
+		if (*buf=='\0') continue;
+		if (fingerprints.Load(buf)) {
+			fprintf(stderr,"ERROR: %s: %s\n",buf,fingerprints.GetErrorStr());
+			fclose(fp);
+			return true;
+		}
+	}
+	fclose(fp);
+	return false;
+}
+
+static void usage(void)
+{
+	printf("Usage: simcompare [-t <threads>] [-o <file>] [-l <list>] <fingerprint> ...\n\n");
+	printf("  -t <threads>  number of threads computing the matrix (default 1)\n");
+	printf("  -o <file>     write the matrix to a file instead of standard output\n");
+	printf("  -l <list>     read the names of the fingerprints from a file, one per line\n\n");
+	printf("The matrix holds the percentage of positions where two fingerprints have\n");
+	printf("the same best move. Fingerprints are epd-files or binary (see fpconvert).\n");
+}
+
+int main(int argc, char* argv[])
+{
+	int threads=1;
+	FILE* out=stdout;
+	int positions;
+
+	for (int a=1; a<argc; a++) {
+		if (strcmp(argv[a],"-t")==0 && a+1<argc) {
+			threads=atoi(argv[++a]);
+			continue;
+		}
+		if (strcmp(argv[a],"-o")==0 && a+1<argc) {
+			out=fopen(argv[++a],"w");
+			if (!out) {
+				fprintf(stderr,"ERROR: Could not create %s\n",argv[a]);
+				return 1;
+			}
+			continue;
+		}
+		if (strcmp(argv[a],"-l")==0 && a+1<argc) {
+			if (loadList(argv[++a]))
+				return 1;
+			continue;
+		}
+		if (*argv[a]=='-') {
+			usage();
+			return 1;
+		}
+		if (fingerprints.Load(argv[a])) {
+			fprintf(stderr,"ERROR: %s: %s\n",argv[a],fingerprints.GetErrorStr());
+			return 1;
+		}
+	}
+
+	count=fingerprints.GetCount();
+	positions=fingerprints.GetPositions();
+	if (count<2 || positions==0) {
+		usage();
+		return 1;
+	}
+	if (threads<1) threads=1;
+
+	matrix=new int[count*count];
+	tiles=(count+TILE-1)/TILE;
+	fprintf(stderr,"Comparing %d fingerprints of %d positions with %d thread(s)\n",
+		count,positions,threads);
+
+	lock.Lock();
+	for (int i=0; i<threads; i++) {
+		runningThreads++;
+		if (StartThread(compareThread,0)) {
+			fprintf(stderr,"ERROR: Could not start a thread\n");
+			runningThreads--;
+			break;
+		}
+	}
+	if (runningThreads==0) {
+		lock.Unlock();
+		return 1;
+	}
+	while (runningThreads>0)
+		allDone.Wait(lock);
+	lock.Unlock();
+
+	for (int j=0; j<count; j++)
+		fprintf(out,"\t%s",fingerprints.GetName(j));
+	fprintf(out,"\n");
+	for (int i=0; i<count; i++) {
+		fprintf(out,"%s",fingerprints.GetName(i));
+		for (int j=0; j<count; j++)
+			fprintf(out,"\t%.2f",100.0*matrix[i*count+j]/positions);
+		fprintf(out,"\n");
+	}
+
+	if (out!=stdout)
+		fclose(out);
+	delete[] matrix;
+	return 0;
+}
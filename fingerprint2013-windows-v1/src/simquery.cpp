@@ -0,0 +1,194 @@
+// simquery.cpp
+// Most similar fingerprints in an archive
+//
+// Copyright (C) 2013, ir. R.L. Pijl
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fparchive.h"
+#include "fpset.h"
+#include "platform.h"
+
+typedef struct {
+	int index;
+	int score;
+} match_t;
+
+static int compareMatches(const void* a, const void* b)
+{
+	// best first, ties in archive order
+	const match_t* ma=(const match_t*)a;
+	const match_t* mb=(const match_t*)b;
+
+	if (ma->score!=mb->score)
+		return mb->score-ma->score;
+	return ma->index-mb->index;
+}
+
+static bool loadList(FingerprintSet* fingerprints, const char* name)
+{
+	char buf[1024];
+	FILE* fp=fopen(name,"r");
+
+	if (!fp) {
+		fprintf(stderr,"ERROR: Could not open %s\n",name);
+		return true;
+	}
+	while (fgets(buf,sizeof(buf),fp)) {
+		buf[strcspn(buf,"\n\r")]='\0';
+		if (*buf=='\0') continue;
+		if (fingerprints->Load(buf)) {
+			fprintf(stderr,"ERROR: %s: %s\n",buf,fingerprints->GetErrorStr());
+			fclose(fp);
+			return true;
+		}
+	}
+	fclose(fp);
+	return false;
+}
+
+static void usage(void)
+{
+	printf("Usage: simquery -build <archive> [-l <list>] <fingerprint> ...\n");
+	printf("       simquery [-k <n>] [-c <n>] [-exact] <archive> <fingerprint>\n\n");
+	printf("  -build <archive>  put the fingerprints in an archive for queries\n");
+	printf("  -l <list>         read the names of the fingerprints from a file, one per line\n");
+	printf("  -k <n>            number of similar fingerprints to list (default 10)\n");
+	printf("  -c <n>            candidates from the sketches that get the exact agreement\n");
+	printf("                    (default 20 times -k, at least 200)\n");
+	printf("  -exact            compute the exact agreement with every fingerprint\n\n");
+	printf("A query lists the fingerprints of the archive with the highest percentage of\n");
+	printf("positions where they have the same best move as the given fingerprint.\n");
+}
+
+static int build(const char* archive, FingerprintSet* fingerprints)
+{
+	const char* error;
+
+	if (fingerprints->GetCount()==0) {
+		usage();
+		return 1;
+	}
+	if (FingerprintArchive::Save(fingerprints,archive,&error)) {
+		fprintf(stderr,"ERROR: %s: %s\n",archive,error);
+		return 1;
+	}
+	fprintf(stderr,"%d fingerprints of %d positions in %s\n",
+		fingerprints->GetCount(),fingerprints->GetPositions(),archive);
+	return 0;
+}
+
+int main(int argc, char* argv[])
+{
+	FingerprintSet fingerprints;
+	FingerprintArchive archive;
+	const char* buildName=0;
+	const char* names[2]={ 0, 0 };
+	int named=0;
+	int k=10;
+	int candidates=0;
+	bool exact=false;
+	fpmove_t sketch[FingerprintArchive::SKETCHSIZE];
+	match_t* matches;
+	int count;
+
+	for (int a=1; a<argc; a++) {
+		if (strcmp(argv[a],"-build")==0 && a+1<argc) {
+			buildName=argv[++a];
+			continue;
+		}
+		if (strcmp(argv[a],"-l")==0 && a+1<argc) {
+			if (loadList(&fingerprints,argv[++a]))
+				return 1;
+			continue;
+		}
+		if (strcmp(argv[a],"-k")==0 && a+1<argc) {
+			k=atoi(argv[++a]);
+			continue;
+		}
+		if (strcmp(argv[a],"-c")==0 && a+1<argc) {
+			candidates=atoi(argv[++a]);
+			continue;
+		}
+		if (strcmp(argv[a],"-exact")==0) {
+			exact=true;
+			continue;
+		}
+		if (*argv[a]=='-') {
+			usage();
+			return 1;
+		}
+		if (buildName) {
+			if (fingerprints.Load(argv[a])) {
+				fprintf(stderr,"ERROR: %s: %s\n",argv[a],fingerprints.GetErrorStr());
+				return 1;
+			}
+			continue;
+		}
+		if (named==2) {
+			usage();
+			return 1;
+		}
+		names[named++]=argv[a];
+	}
+	if (buildName)
+		return build(buildName,&fingerprints);
+	if (named!=2 || k<1) {
+		usage();
+		return 1;
+	}
+
+	if (archive.Open(names[0])) {
+		fprintf(stderr,"ERROR: %s: %s\n",names[0],archive.GetErrorStr());
+		return 1;
+	}
+	if (fingerprints.Load(names[1])) {
+		fprintf(stderr,"ERROR: %s: %s\n",names[1],fingerprints.GetErrorStr());
+		return 1;
+	}
+	if (fingerprints.GetPositions()!=archive.GetPositions()
+	 || fingerprints.GetSuiteHash()!=archive.GetSuiteHash()) {
+		fprintf(stderr,"ERROR: %s is of another position suite than the archive\n",names[1]);
+		return 1;
+	}
+
+	unsigned long long start=TimeUs();
+	const fpmove_t* query=fingerprints.GetMoves(0);
+	int stride=archive.GetStride();
+
+	count=archive.GetCount();
+	matches=new match_t[count];
+	if (candidates<=0)
+		candidates=20*k>200 ? 20*k : 200;
+	if (exact || candidates>count)
+		candidates=count;
+
+	// rank the whole archive on the sketches, unless all are compared
+	// exactly anyway
+	if (candidates<count) {
+		FingerprintArchive::Sketch(query,fingerprints.GetPositions(),sketch);
+		for (int i=0; i<count; i++) {
+			matches[i].index=i;
+			matches[i].score=MoveAgreement(sketch,archive.GetSketch(i),FingerprintArchive::SKETCHSIZE);
+		}
+		qsort(matches,count,sizeof(match_t),compareMatches);
+	} else {
+		for (int i=0; i<count; i++)
+			matches[i].index=i;
+	}
+	for (int i=0; i<candidates; i++)
+		matches[i].score=MoveAgreement(query,archive.GetMoves(matches[i].index),stride);
+	qsort(matches,candidates,sizeof(match_t),compareMatches);
+	unsigned long long elapsed=TimeUs()-start;
+
+	for (int i=0; i<k && i<candidates; i++)
+		printf("%d\t%.2f\t%s\n",i+1,100.0*matches[i].score/archive.GetPositions(),
+			archive.GetName(matches[i].index));
+	fprintf(stderr,"%d of %d fingerprints compared exactly in %.2f ms\n",
+		candidates,count,elapsed/1000.0);
+
+	delete[] matches;
+	return 0;
+}
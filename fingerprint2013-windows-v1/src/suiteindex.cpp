@@ -0,0 +1,145 @@
+// SuiteIndex.cpp
+//
+// Copyright (C) 2008-2013, ir. R.L. Pijl
+
+#include <string.h>
+#include "suiteindex.h"
+#include "position.h"
+
+SuiteIndex::SuiteIndex()
+{
+	keys=0;
+	groupKeys=0;
+	first=0;
+	next=0;
+	table=0;
+	tableMask=0;
+	count=0;
+	distinct=0;
+}
+
+SuiteIndex::~SuiteIndex()
+{
+	Free();
+}
+
+void
+SuiteIndex::Free(void)
+{
+	delete[] keys;
+	delete[] groupKeys;
+	delete[] first;
+	delete[] next;
+	delete[] table;
+	keys=groupKeys=0;
+	first=next=table=0;
+	count=distinct=0;
+}
+
+bool
+SuiteIndex::Build(EpdReader* epd, bool mirrors)
+{
+	epdLine_t line;
+	Position position;
+	char fen[256];
+	int* last;
+	unsigned int size=16;
+
+	Free();
+	count=epd->Count();
+	while (size<2*(unsigned int)count)
+		size<<=1;
+	keys=new uint64_t[count];
+	groupKeys=new uint64_t[count];
+	first=new int[count];
+	next=new int[count];
+	table=new int[size];
+	last=new int[count];
+	tableMask=size-1;
+	memset(table,-1,size*sizeof(int));
+
+	epd->Rewind();
+	for (int i=0; i<count && epd->Next(&line); i++) {
+		int length=line.position.length<(int)sizeof(fen) ? line.position.length : (int)sizeof(fen)-1;
+
+		first[i]=last[i]=i;
+		next[i]=-1;
+		memcpy(fen,line.position.ptr,length);
+		fen[length]='\0';
+		if (position.SetFEN(fen)) {
+			keys[i]=groupKeys[i]=0;
+			distinct++;
+			continue;
+		}
+		keys[i]=groupKeys[i]=position.Key();
+		if (mirrors) {
+			position.Mirror();
+			uint64_t mirrorKey=position.Key();
+			if (mirrorKey<groupKeys[i])
+				groupKeys[i]=mirrorKey;
+		}
+
+		unsigned int slot=(unsigned int)groupKeys[i] & tableMask;
+		while (table[slot]>=0 && groupKeys[table[slot]]!=groupKeys[i])
+			slot=(slot+1) & tableMask;
+		if (table[slot]<0) {
+			table[slot]=i;
+			distinct++;
+		} else {
+			// append to the group, its members stay in epd order
+			int f=table[slot];
+
+			first[i]=f;
+			next[last[f]]=i;
+			last[f]=i;
+		}
+	}
+	delete[] last;
+	epd->Rewind();
+	return false;
+}
+
+int
+SuiteIndex::GetCount(void)
+{
+	return count;
+}
+
+int
+SuiteIndex::GetDistinctCount(void)
+{
+	return distinct;
+}
+
+int
+SuiteIndex::GetFirst(int index)
+{
+	return first[index];
+}
+
+int
+SuiteIndex::GetNext(int index)
+{
+	return next[index];
+}
+
+bool
+SuiteIndex::IsMirrored(int index)
+{
+	return keys[index]!=keys[first[index]];
+}
+
+uint64_t
+SuiteIndex::GetKey(int index)
+{
+	return keys[index];
+}
+
+int
+SuiteIndex::Find(uint64_t groupKey)
+{
+	for (unsigned int slot=(unsigned int)groupKey & tableMask; table && table[slot]>=0; slot=(slot+1) & tableMask)
+		if (groupKeys[table[slot]]==groupKey)
+			return table[slot];
+	return -1;
+}
@@ -0,0 +1,54 @@
+// SuiteIndex.h
+// Index of the distinct positions of an epd-file by Zobrist key
+//
+// Copyright (C) 2008-2013, ir. R.L. Pijl
+
+#ifndef __SUITEINDEX_H
+#define __SUITEINDEX_H
+
+#include <stdint.h>
+#include "epd.h"
+
+// Positions that are equal, or equal after swapping the colours, form a
+// group. Only the first position of a group needs to be searched, the
+// others get its move, mirrored where needed.
+class SuiteIndex
+{
+public:
+	SuiteIndex();
+	virtual ~SuiteIndex();
+
+	// Hashes all positions of the reader and rewinds it. Positions whose
+	// FEN cannot be decoded are never grouped. Returns true on error.
+	bool Build(EpdReader* epd, bool mirrors=true);
+
+	int GetCount(void);
+	int GetDistinctCount(void);
+
+	// First position of the group of index, index itself when it is first
+	int GetFirst(int index);
+	// Next position of the same group, -1 after the last one
+	int GetNext(int index);
+	// Whether the position is the mirror of the first of its group
+	bool IsMirrored(int index);
+
+	// Zobrist key of the position as written, 0 when it could not be decoded
+	uint64_t GetKey(int index);
+	// First position of the group with this key, which is the smaller of
+	// the keys of a position and its mirror. Returns -1 when absent.
+	int Find(uint64_t groupKey);
+
+private:
+	uint64_t* keys;		// key of every position as written
+	uint64_t* groupKeys;	// the smaller of the key and that of the mirror
+	int* first;
+	int* next;
+	int* table;		// open addressing on groupKeys, -1 is empty
+	unsigned int tableMask;
+	int count;
+	int distinct;
+
+	void Free(void);
+};
+
+#endif // __SUITEINDEX_H
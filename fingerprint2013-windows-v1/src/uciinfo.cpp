@@ -0,0 +1,187 @@
+// UCIInfo.cpp
+//
+// Copyright (C) 2008-2013, ir. R.L. Pijl
+
+#include <string.h>
+
+#include "uciinfo.h"
+#include "util.h"
+
+static inline bool isBlank(char c)
+{
+	return c==' ' || c=='\t' || c=='\r' || c=='\n';
+}
+
+static const char* skipBlank(const char* s)
+{
+	while (isBlank(*s)) s++;
+	return s;
+}
+
+static const char* skipWord(const char* s)
+{
+	while (*s && !isBlank(*s)) s++;
+	return s;
+}
+
+// Parse the next word as a number, a word that is no number counts as 0
+static const char* parseNumber(const char* s, long long* value)
+{
+	bool negative=false;
+	long long v=0;
+
+	s=skipBlank(s);
+	if (*s=='-' || *s=='+')
+		negative=*s++=='-';
+	while (*s>='0' && *s<='9')
+		v=v*10+(*s++-'0');
+	*value=negative ? -v : v;
+	return skipWord(s);
+}
+
+static const char* parseInt(const char* s, int* value)
+{
+	long long v;
+
+	s=parseNumber(s,&v);
+	*value=(int)v;
+	return s;
+}
+
+// Move in coordinate notation, copied because ParseMove needs a terminator
+static const char* parseMove(const char* s, int* move)
+{
+	char buf[6];
+	const char* end;
+	int n;
+
+	s=skipBlank(s);
+	end=skipWord(s);
+	n=(int)(end-s);
+	if (n>=4 && n<=5) {
+		memcpy(buf,s,n);
+		buf[n]='\0';
+		*move=ParseMove(buf);
+	}
+	return end;
+}
+
+#define KEYWORD(word) (n==sizeof(word)-1 && memcmp(s,word,sizeof(word)-1)==0)
+
+void ParseUCIInfo(const char* line, uciInfo_t* info)
+{
+	const char* s=line;
+
+	info->multi=0;
+	info->depth=-1;
+	info->seldepth=-1;
+	info->score=0;
+	info->time=-1;
+	info->nodes=-1;
+	info->nps=-1;
+	info->tbhits=-1;
+	info->hashfull=0;
+	info->currmove=0;
+	info->currmovenr=-1;
+	info->pv=0;
+	info->string=0;
+
+	for (;;) {
+		const char* end;
+		int n;
+
+		s=skipBlank(s);
+		if (*s=='\0')
+			return;
+		end=skipWord(s);
+		n=(int)(end-s);
+
+		// whole keywords only, dispatched on their first character
+		switch (*s) {
+		case 'c':
+			if (KEYWORD("currmove")) {
+				s=parseMove(end,&info->currmove);
+				continue;
+			}
+			if (KEYWORD("currmovenumber")) {
+				s=parseInt(end,&info->currmovenr);
+				continue;
+			}
+			break;
+		case 'd':
+			if (KEYWORD("depth")) {
+				s=parseInt(end,&info->depth);
+				continue;
+			}
+			break;
+		case 'h':
+			if (KEYWORD("hashfull")) {
+				s=parseInt(end,&info->hashfull);
+				continue;
+			}
+			break;
+		case 'm':
+			if (KEYWORD("multipv")) {
+				s=parseInt(end,&info->multi);
+				continue;
+			}
+			break;
+		case 'n':
+			if (KEYWORD("nodes")) {
+				s=parseNumber(end,&info->nodes);
+				continue;
+			}
+			if (KEYWORD("nps")) {
+				s=parseNumber(end,&info->nps);
+				continue;
+			}
+			break;
+		case 'p':
+			if (KEYWORD("pv")) {
+				info->pv=skipBlank(end);
+				return;
+			}
+			break;
+		case 's':
+			if (KEYWORD("score")) {
+				const char* type=skipBlank(end);
+
+				s=skipWord(type);
+				n=(int)(s-type);
+				if (n==2 && memcmp(type,"cp",2)==0)
+					s=parseInt(s,&info->score);
+				else if (n==4 && memcmp(type,"mate",4)==0) {
+					int mate;
+
+					s=parseInt(s,&mate);
+					if (mate>0)
+						info->score=100000-mate;
+					else if (mate<0)
+						info->score=-100000-mate;
+				}
+				continue;
+			}
+			if (KEYWORD("seldepth")) {
+				s=parseInt(end,&info->seldepth);
+				continue;
+			}
+			if (KEYWORD("string")) {
+				info->string=skipBlank(end);
+				return;
+			}
+			break;
+		case 't':
+			if (KEYWORD("time")) {
+				s=parseInt(end,&info->time);
+				continue;
+			}
+			if (KEYWORD("tbhits")) {
+				s=parseInt(end,&info->tbhits);
+				continue;
+			}
+			break;
+		}
+		// unknown words and bounds such as 'lowerbound' are skipped
+		s=end;
+	}
+}
@@ -0,0 +1,31 @@
+// UCIInfo.h
+// Single pass parser of the UCI 'info' line
+//
+// Copyright (C) 2008-2013, ir. R.L. Pijl
+
+#ifndef __UCIINFO_H
+#define __UCIINFO_H
+
+// Fields that are absent keep the value set by ParseUCIInfo: -1 for counts
+// and limits, 0 for multipv, score, hashfull and the moves.
+typedef struct {
+	int multi;
+	int depth;
+	int seldepth;
+	int score;          // centipawns, mate scores as +-(100000-n)
+	int time;
+	long long nodes;
+	long long nps;
+	int tbhits;
+	int hashfull;
+	int currmove;
+	int currmovenr;
+	const char* pv;     // rest of the line after 'pv', or 0
+	const char* string; // rest of the line after 'string', or 0
+} uciInfo_t;
+
+// Parse the line following the 'info' keyword. The line is not modified; pv
+// and string point into it and run up to the end of the line.
+void ParseUCIInfo(const char* line, uciInfo_t* info);
+
+#endif // __UCIINFO_H
@@ -1,12 +1,16 @@
-// util.h
-// Utility functions
-// Copyright (C) 2008-2013, ir. R.L. Pijl
-
-#ifndef __UTIL_H
-#define __UTIL_H
-
-int ParseMove(const char*);
-const char* MoveStr(int);
-//int incheck(const char*);
-
-#endif
+// util.h
+// Utility functions
+// Copyright (C) 2008-2013, ir. R.L. Pijl
+
+#ifndef __UTIL_H
+#define __UTIL_H
+
+int ParseMove(const char*);
+const char* MoveStr(int);
+
+// Reentrant replacement of strtok: returns the next token of *s delimited by
+// any of the characters in delim and advances *s past it, or 0 at the end.
+char* NextToken(char** s, const char* delim);
+//int incheck(const char*);
+
+#endif